@@ -0,0 +1,146 @@
+/*
+
+    Copyright (C) 2013  Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+
+#include "appinfocache_p.h"
+#include <libfm/fm.h>
+
+namespace Fm {
+
+AppInfoCache* AppInfoCache::sharedCache_ = NULL;
+
+AppInfoCache::AppInfoCache() {
+#if GLIB_CHECK_VERSION(2, 40, 0)
+  // emitted when any desktop entry dir or mimeapps.list is changed
+  appInfoMonitor_ = g_app_info_monitor_get();
+  g_signal_connect(appInfoMonitor_, "changed", G_CALLBACK(onAppInfoChanged), this);
+#else
+  // mimeapps.list
+  addMonitor(g_get_user_config_dir());
+  // desktop entries
+  char* dirPath = g_build_filename(g_get_user_data_dir(), "applications", NULL);
+  addMonitor(dirPath);
+  g_free(dirPath);
+  for(const gchar* const* dataDir = g_get_system_data_dirs(); *dataDir; ++dataDir) {
+    dirPath = g_build_filename(*dataDir, "applications", NULL);
+    addMonitor(dirPath);
+    g_free(dirPath);
+  }
+#endif
+}
+
+AppInfoCache::~AppInfoCache() {
+  clear();
+#if GLIB_CHECK_VERSION(2, 40, 0)
+  g_signal_handlers_disconnect_by_func(appInfoMonitor_, (gpointer)G_CALLBACK(onAppInfoChanged), this);
+  g_object_unref(appInfoMonitor_);
+#else
+  Q_FOREACH(GFileMonitor* monitor, monitors_) {
+    g_signal_handlers_disconnect_by_func(monitor, (gpointer)G_CALLBACK(onDirChanged), this);
+    g_object_unref(monitor);
+  }
+#endif
+}
+
+// static
+AppInfoCache* AppInfoCache::sharedCache() {
+  if(!sharedCache_)
+    sharedCache_ = new AppInfoCache();
+  return sharedCache_;
+}
+
+// static
+void AppInfoCache::freeSharedCache() {
+  delete sharedCache_;
+  sharedCache_ = NULL;
+}
+
+const QList<GAppInfo*>& AppInfoCache::appsForType(const char* mimeType) {
+  QByteArray key(mimeType);
+  QHash<QByteArray, QList<GAppInfo*> >::iterator it = apps_.find(key);
+  if(it == apps_.end()) {
+    QList<GAppInfo*> apps;
+    GList* allApps = g_app_info_get_all_for_type(mimeType);
+    for(GList* l = allApps; l; l = l->next) {
+      GAppInfo* app = G_APP_INFO(l->data);
+      // check if the command really exists
+      if(isProgramInPath(g_app_info_get_executable(app)))
+        apps.append(app); // steal the ref
+      else
+        g_object_unref(app);
+    }
+    g_list_free(allApps);
+    it = apps_.insert(key, apps);
+  }
+  return it.value();
+}
+
+// many apps share the same executable, so the results are cached as well
+bool AppInfoCache::isProgramInPath(const char* program) {
+  if(!program)
+    return false;
+  QByteArray key(program);
+  QHash<QByteArray, bool>::const_iterator it = programs_.constFind(key);
+  if(it != programs_.constEnd())
+    return it.value();
+  gchar* programPath = g_find_program_in_path(program);
+  bool found = (programPath != NULL);
+  g_free(programPath);
+  programs_.insert(key, found);
+  return found;
+}
+
+void AppInfoCache::clear() {
+  QHash<QByteArray, QList<GAppInfo*> >::iterator it;
+  for(it = apps_.begin(); it != apps_.end(); ++it) {
+    Q_FOREACH(GAppInfo* app, it.value())
+      g_object_unref(app);
+  }
+  apps_.clear();
+  programs_.clear();
+}
+
+#if GLIB_CHECK_VERSION(2, 40, 0)
+
+// static
+void AppInfoCache::onAppInfoChanged(GAppInfoMonitor* monitor, AppInfoCache* pThis) {
+  pThis->clear();
+}
+
+#else
+
+void AppInfoCache::addMonitor(const char* dirPath) {
+  GFile* gf = g_file_new_for_path(dirPath);
+  GFileMonitor* monitor = fm_monitor_directory(gf, NULL);
+  g_object_unref(gf);
+  if(monitor) {
+    g_signal_connect(monitor, "changed", G_CALLBACK(onDirChanged), this);
+    monitors_.append(monitor);
+  }
+}
+
+// static
+void AppInfoCache::onDirChanged(GFileMonitor* monitor, GFile* gf, GFile* other, GFileMonitorEvent evt, AppInfoCache* pThis) {
+  pThis->clear();
+}
+
+#endif
+
+} // namespace Fm
@@ -0,0 +1,72 @@
+/*
+
+    Copyright (C) 2013  Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+
+#ifndef FM_APPINFOCACHE_P_H
+#define FM_APPINFOCACHE_P_H
+
+#include <QHash>
+#include <QList>
+#include <QByteArray>
+#include <gio/gio.h>
+
+namespace Fm {
+
+// Cache of the applications which can open a given mime type, used by the
+// "Open With..." menu of FileMenu. Only the apps whose executables are found
+// in $PATH are kept, so the lookups are done only once per mime type.
+// The whole cache is dropped when the desktop entries or mimeapps.list change.
+class AppInfoCache {
+public:
+  static AppInfoCache* sharedCache();
+  static void freeSharedCache();
+
+  // the returned GAppInfos are owned by the cache. ref them if they are kept.
+  const QList<GAppInfo*>& appsForType(const char* mimeType);
+
+  void clear();
+
+private:
+  AppInfoCache();
+  ~AppInfoCache();
+
+  bool isProgramInPath(const char* program);
+
+#if GLIB_CHECK_VERSION(2, 40, 0)
+  static void onAppInfoChanged(GAppInfoMonitor* monitor, AppInfoCache* pThis);
+#else
+  void addMonitor(const char* dirPath);
+  static void onDirChanged(GFileMonitor* monitor, GFile* gf, GFile* other, GFileMonitorEvent evt, AppInfoCache* pThis);
+#endif
+
+private:
+  QHash<QByteArray, QList<GAppInfo*> > apps_; // mime type => apps
+  QHash<QByteArray, bool> programs_; // executable => found in $PATH
+#if GLIB_CHECK_VERSION(2, 40, 0)
+  GAppInfoMonitor* appInfoMonitor_;
+#else
+  QList<GFileMonitor*> monitors_;
+#endif
+  static AppInfoCache* sharedCache_;
+};
+
+}
+
+#endif // FM_APPINFOCACHE_P_H
@@ -0,0 +1,210 @@
+/*
+
+    Copyright (C) 2013  Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+
+#include "appmenumodel_p.h"
+#include "appmenuview_p.h"
+#include "trace.h"
+#include <QThreadPool>
+#include <QRunnable>
+#include <QMutexLocker>
+#include <QHash>
+
+namespace Fm {
+
+AppMenuModel* AppMenuModel::sharedModel_ = NULL;
+
+// walk the menu in a worker thread. only plain data is collected here,
+// and the items of the model are created in the main thread.
+class AppMenuModel::BuildTask : public QRunnable {
+public:
+  BuildTask(AppMenuModel* model, MenuCacheDir* root):
+    model_(model),
+    root_(root) {
+  }
+
+  virtual ~BuildTask() {
+    menu_cache_item_unref(MENU_CACHE_ITEM(root_));
+  }
+
+  virtual void run() {
+    TraceScope trace("AppMenuModel: walk the menu");
+    QList<AppMenuNode*>* nodes = new QList<AppMenuNode*>();
+    addNodes(*nodes, root_);
+    {
+      QMutexLocker locker(&model_->lock_);
+      if(model_->builtNodes_) { // replaced by the newer result
+        qDeleteAll(*model_->builtNodes_);
+        delete model_->builtNodes_;
+      }
+      model_->builtNodes_ = nodes;
+    }
+    QMetaObject::invokeMethod(model_, "onBuildFinished", Qt::QueuedConnection);
+  }
+
+private:
+  static void addNodes(QList<AppMenuNode*>& nodes, MenuCacheDir* dir) {
+    GSList* list = menu_cache_dir_list_children(dir);
+    for(GSList* l = list; l; l = l->next) {
+      MenuCacheItem* item = MENU_CACHE_ITEM(l->data);
+      MenuCacheType type = menu_cache_item_get_type(item);
+      if(type == MENU_CACHE_TYPE_APP || type == MENU_CACHE_TYPE_DIR) {
+        AppMenuNode* node = new AppMenuNode(item);
+        if(type == MENU_CACHE_TYPE_DIR)
+          addNodes(node->children, MENU_CACHE_DIR(item));
+        nodes.append(node);
+      }
+    }
+    g_slist_free_full(list, (GDestroyNotify)menu_cache_item_unref);
+  }
+
+private:
+  AppMenuModel* model_;
+  MenuCacheDir* root_;
+};
+
+AppMenuModel::AppMenuModel():
+  QStandardItemModel(),
+  menuCache_(NULL),
+  reloadNotify_(NULL),
+  pool_(new QThreadPool()),
+  builtNodes_(NULL),
+  loaded_(false) {
+
+  pool_->setMaxThreadCount(1); // the builds are done in order
+
+  TraceScope trace("menu_cache_lookup");
+  // ensure that we're using lxmenu-data (FIXME: should we do this?)
+  QByteArray oldenv = qgetenv("XDG_MENU_PREFIX");
+  qputenv("XDG_MENU_PREFIX", "lxde-");
+  menuCache_ = menu_cache_lookup("applications.menu");
+  qputenv("XDG_MENU_PREFIX", oldenv); // restore the original value if needed
+  trace.end();
+
+  if(menuCache_) {
+    reloadNotify_ = menu_cache_add_reload_notify(menuCache_, onMenuCacheReload, this);
+    // if the menu is not loaded yet, it's built when the reload notification comes
+    MenuCacheDir* root = menu_cache_dup_root_dir(menuCache_);
+    if(root)
+      startBuild(root);
+  }
+}
+
+AppMenuModel::~AppMenuModel() {
+  if(menuCache_) {
+    if(reloadNotify_)
+      menu_cache_remove_reload_notify(menuCache_, reloadNotify_);
+  }
+  pool_->waitForDone();
+  delete pool_;
+  if(builtNodes_) {
+    qDeleteAll(*builtNodes_);
+    delete builtNodes_;
+  }
+  clear(); // the items hold references to the menu cache
+  if(menuCache_)
+    menu_cache_unref(menuCache_);
+}
+
+// static
+AppMenuModel* AppMenuModel::sharedModel() {
+  if(!sharedModel_)
+    sharedModel_ = new AppMenuModel();
+  return sharedModel_;
+}
+
+// static
+void AppMenuModel::freeSharedModel() {
+  delete sharedModel_;
+  sharedModel_ = NULL;
+}
+
+// takes the ownership of the root dir
+void AppMenuModel::startBuild(MenuCacheDir* root) {
+  pool_->start(new BuildTask(this, root));
+}
+
+// static
+void AppMenuModel::onMenuCacheReload(MenuCache* mc, gpointer user_data) {
+  AppMenuModel* pThis = static_cast<AppMenuModel*>(user_data);
+  MenuCacheDir* root = menu_cache_dup_root_dir(mc);
+  if(root)
+    pThis->startBuild(root);
+}
+
+void AppMenuModel::onBuildFinished() {
+  QList<AppMenuNode*>* nodes;
+  {
+    QMutexLocker locker(&lock_);
+    nodes = builtNodes_;
+    builtNodes_ = NULL;
+  }
+  if(!nodes) // already handled with an earlier notification
+    return;
+
+  TraceScope trace("AppMenuModel::mergeItems");
+  mergeItems(invisibleRootItem(), *nodes);
+  qDeleteAll(*nodes);
+  delete nodes;
+  loaded_ = true;
+  Q_EMIT loaded();
+}
+
+static inline QByteArray itemKey(MenuCacheItem* item) {
+  QByteArray key(menu_cache_item_get_id(item));
+  key += char('0' + menu_cache_item_get_type(item));
+  return key;
+}
+
+// make the children of the parent match the nodes. the existing items are
+// reused, so only the changes of the menu are passed to the views.
+void AppMenuModel::mergeItems(QStandardItem* parent, const QList<AppMenuNode*>& nodes) {
+  QHash<QByteArray, AppMenuViewItem*> oldItems;
+  for(int row = 0; row < parent->rowCount(); ++row) {
+    AppMenuViewItem* item = static_cast<AppMenuViewItem*>(parent->child(row));
+    oldItems.insert(itemKey(item->item()), item);
+  }
+
+  for(int i = 0; i < nodes.size(); ++i) {
+    AppMenuNode* node = nodes.at(i);
+    AppMenuViewItem* item = oldItems.take(itemKey(node->item));
+    if(item) {
+      int row = item->row();
+      if(row != i)
+        parent->insertRow(i, parent->takeRow(row));
+      item->setItem(node->item);
+      if(item->isDir())
+        mergeItems(item, node->children);
+    }
+    else {
+      // fill the new item before adding it, so the views are notified only once
+      item = new AppMenuViewItem(node->item);
+      if(item->isDir())
+        mergeItems(item, node->children);
+      parent->insertRow(i, item);
+    }
+  }
+
+  // the items left are removed from the menu
+  if(parent->rowCount() > nodes.size())
+    parent->removeRows(nodes.size(), parent->rowCount() - nodes.size());
+}
+
+}
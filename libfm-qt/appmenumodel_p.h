@@ -0,0 +1,92 @@
+/*
+
+    Copyright (C) 2013  Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+
+#ifndef FM_APPMENUMODEL_P_H
+#define FM_APPMENUMODEL_P_H
+
+#include <QStandardItemModel>
+#include <QList>
+#include <QMutex>
+#include <menu-cache/menu-cache.h>
+
+class QThreadPool;
+
+namespace Fm {
+
+// a menu item collected in a worker thread
+struct AppMenuNode {
+  explicit AppMenuNode(MenuCacheItem* menuItem):
+    item(menu_cache_item_ref(menuItem)) {
+  }
+  ~AppMenuNode() {
+    qDeleteAll(children);
+    menu_cache_item_unref(item);
+  }
+
+  MenuCacheItem* item;
+  QList<AppMenuNode*> children;
+};
+
+// The model of the application menu shared by all AppMenuView widgets.
+// It's created when it's first used, and the menu is walked in a worker
+// thread. After the menu cache is reloaded, the items are updated in
+// place, so the views keep their selection.
+class AppMenuModel : public QStandardItemModel {
+  Q_OBJECT
+public:
+  static AppMenuModel* sharedModel();
+  static void freeSharedModel();
+
+  // true after the items are added for the first time
+  bool isLoaded() const {
+    return loaded_;
+  }
+
+Q_SIGNALS:
+  void loaded();
+
+private Q_SLOTS:
+  void onBuildFinished();
+
+private:
+  class BuildTask;
+
+  AppMenuModel();
+  virtual ~AppMenuModel();
+
+  void startBuild(MenuCacheDir* root);
+  void mergeItems(QStandardItem* parent, const QList<AppMenuNode*>& nodes);
+  static void onMenuCacheReload(MenuCache* mc, gpointer user_data);
+
+private:
+  MenuCache* menuCache_;
+  MenuCacheNotifyId reloadNotify_;
+  QThreadPool* pool_;
+  QMutex lock_;
+  QList<AppMenuNode*>* builtNodes_; // the result of the latest build
+  bool loaded_;
+
+  static AppMenuModel* sharedModel_;
+};
+
+}
+
+#endif // FM_APPMENUMODEL_P_H
@@ -22,87 +22,33 @@
 #include <QStandardItemModel>
 #include "icontheme.h"
 #include "appmenuview_p.h"
+#include "appmenumodel_p.h"
 #include <gio/gdesktopappinfo.h>
 
 namespace Fm {
 
 AppMenuView::AppMenuView(QWidget* parent):
-  model_(new QStandardItemModel()),
-  menu_cache(NULL),
-  menu_cache_reload_notify(NULL),
+  model_(AppMenuModel::sharedModel()),
   QTreeView(parent) {
 
   setHeaderHidden(true);
   setSelectionMode(SingleSelection);
 
-  // initialize model
-  // TODO: share one model among all app menu view widgets
-  // ensure that we're using lxmenu-data (FIXME: should we do this?)
-  QByteArray oldenv = qgetenv("XDG_MENU_PREFIX");
-  qputenv("XDG_MENU_PREFIX", "lxde-");
-  menu_cache = menu_cache_lookup("applications.menu");
-  // if(!oldenv.isEmpty())
-  qputenv("XDG_MENU_PREFIX", oldenv); // restore the original value if needed
-
-  if(menu_cache) {
-    MenuCacheDir* dir = menu_cache_dup_root_dir(menu_cache);
-    menu_cache_reload_notify = menu_cache_add_reload_notify(menu_cache, _onMenuCacheReload, this);
-    if(dir) { /* content of menu is already loaded */
-      addMenuItems(NULL, dir);
-      menu_cache_item_unref(MENU_CACHE_ITEM(dir));
-    }
-  }
   setModel(model_);
   connect(selectionModel(), SIGNAL(selectionChanged(QItemSelection,QItemSelection)), SIGNAL(selectionChanged()));
-  selectionModel()->select(model_->index(0, 0), QItemSelectionModel::SelectCurrent);
+  // the menu might still be loaded in another thread
+  connect(model_, SIGNAL(loaded()), SLOT(onModelLoaded()));
+  if(static_cast<AppMenuModel*>(model_)->isLoaded())
+    onModelLoaded();
 }
 
 AppMenuView::~AppMenuView() {
-  delete model_;
-  if(menu_cache) {
-    if(menu_cache_reload_notify)
-      menu_cache_remove_reload_notify(menu_cache, menu_cache_reload_notify);
-    menu_cache_unref(menu_cache);
-  }
-}
-
-void AppMenuView::addMenuItems(QStandardItem* parentItem, MenuCacheDir* dir) {
-  GSList* l;
-  GSList* list;
-  /* Iterate over all menu items in this directory. */
-  for(l = list = menu_cache_dir_list_children(dir); l != NULL; l = l->next) {
-    /* Get the menu item. */
-    MenuCacheItem* menuItem = MENU_CACHE_ITEM(l->data);
-    switch(menu_cache_item_get_type(menuItem)) {
-    case MENU_CACHE_TYPE_NONE:
-    case MENU_CACHE_TYPE_SEP:
-      break;
-    case MENU_CACHE_TYPE_APP:
-    case MENU_CACHE_TYPE_DIR: {
-      AppMenuViewItem* newItem = new AppMenuViewItem(menuItem);
-      if(parentItem)
-        parentItem->insertRow(parentItem->rowCount(), newItem);
-      else
-        model_->insertRow(model_->rowCount(), newItem);
-
-      if(menu_cache_item_get_type(menuItem) == MENU_CACHE_TYPE_DIR)
-        addMenuItems(newItem, MENU_CACHE_DIR(menuItem));
-      break;
-    }
-    }
-  }
-  g_slist_free_full(list, (GDestroyNotify)menu_cache_item_unref);
 }
 
-void AppMenuView::onMenuCacheReload(MenuCache* mc) {
-  MenuCacheDir* dir = menu_cache_dup_root_dir(mc);
-  model_->clear();
-  /* FIXME: preserve original selection */
-  if(dir) {
-    addMenuItems(NULL, dir);
-    menu_cache_item_unref(MENU_CACHE_ITEM(dir));
+void AppMenuView::onModelLoaded() {
+  // the selection is kept when the menu is updated
+  if(!selectionModel()->hasSelection())
     selectionModel()->select(model_->index(0, 0), QItemSelectionModel::SelectCurrent);
-  }
 }
 
 bool AppMenuView::isAppSelected() {
@@ -51,21 +51,16 @@ public:
 
 Q_SIGNALS:
   void selectionChanged();
+
+private Q_SLOTS:
+  void onModelLoaded();
   
 private:
-  void addMenuItems(QStandardItem* parentItem, MenuCacheDir* dir);
-  void onMenuCacheReload(MenuCache* mc);
-  static void _onMenuCacheReload(MenuCache* mc, gpointer user_data) {
-    static_cast<AppMenuView*>(user_data)->onMenuCacheReload(mc);
-  }
-
   AppMenuViewItem* selectedItem();
 
 private:
   // gboolean fm_app_menu_view_is_item_app(, GtkTreeIter* it);
-  QStandardItemModel* model_;
-  MenuCache* menu_cache;
-  MenuCacheNotifyId menu_cache_reload_notify;
+  QStandardItemModel* model_; // shared by all app menu views
 };
 
 }
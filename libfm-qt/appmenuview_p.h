@@ -30,19 +30,11 @@ namespace Fm {
 class AppMenuViewItem : public QStandardItem {
 public:
   explicit AppMenuViewItem(MenuCacheItem* item):
-    item_(menu_cache_item_ref(item)) {
-    FmIcon* fmicon;
-    if(menu_cache_item_get_icon(item))
-      fmicon = fm_icon_from_name(menu_cache_item_get_icon(item));
-    else
-      fmicon = NULL;
+    item_(menu_cache_item_ref(item)),
+    iconLoaded_(false) {
     setText(QString::fromUtf8(menu_cache_item_get_name(item)));
     setEditable(false);
     setDragEnabled(false);
-    if(fmicon) {
-      setIcon(IconTheme::icon(fmicon));
-      fm_icon_unref(fmicon);
-    }
   }
 
   ~AppMenuViewItem() {
@@ -52,6 +44,34 @@ public:
   MenuCacheItem* item() {
     return item_;
   }
+
+  // replace the menu item after the menu cache is reloaded
+  void setItem(MenuCacheItem* item) {
+    menu_cache_item_ref(item);
+    menu_cache_item_unref(item_);
+    item_ = item;
+    iconLoaded_ = false;
+    setText(QString::fromUtf8(menu_cache_item_get_name(item)));
+  }
+
+  // the icons are only loaded for the items shown in the views
+  virtual QVariant data(int role = Qt::UserRole + 1) const {
+    if(role == Qt::DecorationRole) {
+      if(!iconLoaded_) {
+        const char* iconName = menu_cache_item_get_icon(item_);
+        if(iconName) {
+          FmIcon* fmicon = fm_icon_from_name(iconName);
+          icon_ = IconTheme::icon(fmicon);
+          fm_icon_unref(fmicon);
+        }
+        else
+          icon_ = QIcon();
+        iconLoaded_ = true;
+      }
+      return QVariant(icon_);
+    }
+    return QStandardItem::data(role);
+  }
   
   MenuCacheType type() {
 	return menu_cache_item_get_type(item_);
@@ -67,6 +87,8 @@ public:
 
 private:
   MenuCacheItem* item_;
+  mutable QIcon icon_;
+  mutable bool iconLoaded_;
 };
 
 }
@@ -23,6 +23,8 @@
 
 #include "libfmqtglobals.h"
 #include <QVector>
+#include <QString>
+#include <QStringList>
 #include <libfm/fm.h>
 
 namespace Fm {
@@ -46,7 +48,9 @@ public:
 
   BrowseHistoryItem(const BrowseHistoryItem& other):
     path_(other.path_ ? fm_path_ref(other.path_) : NULL),
-    scrollPos_(other.scrollPos_) {
+    scrollPos_(other.scrollPos_),
+    currentFile_(other.currentFile_),
+    selectedFiles_(other.selectedFiles_) {
   }
 
   ~BrowseHistoryItem() {
@@ -59,6 +63,8 @@ public:
       fm_path_unref(path_);
     path_ = other.path_ ? fm_path_ref(other.path_) : NULL;
     scrollPos_ = other.scrollPos_;
+    currentFile_ = other.currentFile_;
+    selectedFiles_ = other.selectedFiles_;
     return *this;
   }
   
@@ -74,12 +80,29 @@ public:
     scrollPos_ = pos;
   }
 
+  // name of the file having the keyboard focus
+  QString currentFile() const {
+    return currentFile_;
+  }
+
+  void setCurrentFile(const QString& name) {
+    currentFile_ = name;
+  }
+
+  // names of the selected files
+  QStringList selectedFiles() const {
+    return selectedFiles_;
+  }
+
+  void setSelectedFiles(const QStringList& names) {
+    selectedFiles_ = names;
+  }
+
 private:
   FmPath* path_;
   int scrollPos_;
-  // TODO: we may need to store current selection as well. reserve room for furutre expansion.
-  // void* reserved1;
-  // void* reserved2;
+  QString currentFile_;
+  QStringList selectedFiles_;
 };
 
 class LIBFM_QT_API BrowseHistory : public QVector<BrowseHistoryItem> {
@@ -24,10 +24,15 @@ using namespace Fm;
 
 static GQuark data_id = 0;
 
+QList<CachedFolderModel*> CachedFolderModel::retainedModels_;
+int CachedFolderModel::maxRetainedModels_ = 8;
+qint64 CachedFolderModel::maxRetainedMemory_ = 64 * 1024 * 1024;
+
 
 CachedFolderModel::CachedFolderModel(FmFolder* folder):
   FolderModel(),
-  refCount(1) {
+  refCount(1),
+  retainedSize_(0) {
 
   FolderModel::setFolder(folder);
 }
@@ -44,6 +49,8 @@ CachedFolderModel* CachedFolderModel::modelFromFolder(FmFolder* folder) {
   model = reinterpret_cast<CachedFolderModel*>(qdata);
   if(model) {
     // qDebug("cache found!!");
+    if(model->refCount <= 0) // take it out of the retention pool
+      retainedModels_.removeOne(model);
     model->ref();
   }
   else {
@@ -53,6 +60,12 @@ CachedFolderModel* CachedFolderModel::modelFromFolder(FmFolder* folder) {
   return model;
 }
 
+CachedFolderModel* CachedFolderModel::findModel(FmFolder* folder) {
+  if(!data_id)
+    return NULL;
+  return reinterpret_cast<CachedFolderModel*>(g_object_get_qdata(G_OBJECT(folder), data_id));
+}
+
 CachedFolderModel* CachedFolderModel::modelFromPath(FmPath* path) {
   FmFolder* folder = fm_folder_from_path(path);
   if(folder) {
@@ -67,8 +80,66 @@ void CachedFolderModel::unref() {
   // qDebug("unref cache");
   --refCount;
   if(refCount <= 0) {
-    g_object_set_qdata(G_OBJECT(folder()), data_id, NULL);
-    deleteLater();
+    if(maxRetainedModels_ > 0) {
+      // keep the model attached to the folder so it still receives updates
+      // and can be reused immediately if the folder is opened again.
+      retainedSize_ = memoryUsage();
+      retainedModels_.prepend(this);
+      trimRetainedModels();
+    }
+    else
+      destroy();
+  }
+}
+
+void CachedFolderModel::destroy() {
+  g_object_set_qdata(G_OBJECT(folder()), data_id, NULL);
+  deleteLater();
+}
+
+// rough estimation of the memory used by the items and their thumbnails
+qint64 CachedFolderModel::memoryUsage() {
+  qint64 size = 0;
+  int n = rowCount();
+  for(int row = 0; row < n; ++row) {
+    FolderModelItem* item = itemFromIndex(index(row, 0));
+    // the FmFileInfo and the QIcon are counted as a fixed overhead
+    size += sizeof(FolderModelItem) + 256 + item->displayName.size() * sizeof(QChar);
+    Q_FOREACH(const FolderModelItem::Thumbnail& thumbnail, item->thumbnails) {
+#if QT_VERSION >= 0x050a00
+      size += thumbnail.image.sizeInBytes();
+#else
+      size += thumbnail.image.byteCount();
+#endif
+    }
   }
+  return size;
+}
+
+// static
+// free the least recently released models until the pool fits the limits
+void CachedFolderModel::trimRetainedModels() {
+  qint64 total = 0;
+  Q_FOREACH(CachedFolderModel* model, retainedModels_) {
+    total += model->retainedSize_;
+  }
+  while(!retainedModels_.isEmpty()
+        && (retainedModels_.size() > maxRetainedModels_ || total > maxRetainedMemory_)) {
+    CachedFolderModel* model = retainedModels_.takeLast();
+    total -= model->retainedSize_;
+    model->destroy();
+  }
+}
+
+// static
+void CachedFolderModel::setMaxRetainedModels(int max) {
+  maxRetainedModels_ = max;
+  trimRetainedModels();
+}
+
+// static
+void CachedFolderModel::setMaxRetainedMemory(qint64 bytes) {
+  maxRetainedMemory_ = bytes;
+  trimRetainedModels();
 }
 
@@ -23,6 +23,7 @@
 
 #include "libfmqtglobals.h"
 #include "foldermodel.h"
+#include <QList>
 
 namespace Fm {
   
@@ -37,12 +38,36 @@ public:
 
   static CachedFolderModel* modelFromFolder(FmFolder* folder);
   static CachedFolderModel* modelFromPath(FmPath* path);
+  // get the existing model of the folder without creating one or adding a reference
+  static CachedFolderModel* findModel(FmFolder* folder);
+
+  // Models no longer referenced are retained for a while so going back
+  // to a recently visited folder does not need to rebuild the model.
+  // The pool is bounded by the number of models and their estimated memory.
+  static int maxRetainedModels() {
+    return maxRetainedModels_;
+  }
+  static void setMaxRetainedModels(int max);
+
+  static qint64 maxRetainedMemory() {
+    return maxRetainedMemory_;
+  }
+  static void setMaxRetainedMemory(qint64 bytes);
 
 private:
   virtual ~CachedFolderModel();
   void setFolder(FmFolder* folder);
+  void destroy();
+  qint64 memoryUsage();
+  static void trimRetainedModels();
+
 private:
   int refCount;
+  qint64 retainedSize_;
+
+  static QList<CachedFolderModel*> retainedModels_; // most recently released first
+  static int maxRetainedModels_;
+  static qint64 maxRetainedMemory_;
 };
 
 
@@ -0,0 +1,196 @@
+/*
+
+    Copyright (C) 2013  Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#include "conflictdialog_p.h"
+#include "ui_conflict-dialog.h"
+#include <QTreeWidgetItem>
+#include <QDateTime>
+#include <QRegExp>
+#include <QStyledItemDelegate>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+using namespace Fm;
+
+namespace Fm {
+
+// only the new name can be edited
+class NewNameDelegate : public QStyledItemDelegate {
+public:
+  NewNameDelegate(int column, QObject* parent):
+    QStyledItemDelegate(parent),
+    column_(column) {
+  }
+
+  virtual QWidget* createEditor(QWidget* parent, const QStyleOptionViewItem& option, const QModelIndex& index) const {
+    if(index.column() != column_)
+      return NULL;
+    return QStyledItemDelegate::createEditor(parent, option, index);
+  }
+
+private:
+  int column_;
+};
+
+}
+
+ConflictDialog::ConflictDialog(QList<FileConflict>& conflicts, QWidget* parent):
+  QDialog(parent),
+  conflicts_(conflicts) {
+
+  ui = new Ui::ConflictDialog();
+  ui->setupUi(this);
+  ui->message->setText(tr("%1 files already exist in the destination folder. Other files have been processed. Choose what to do with these ones.")
+                       .arg(conflicts.size()));
+
+  // there can be many thousands of them, so add all items at once
+  QList<QTreeWidgetItem*> items;
+  items.reserve(conflicts.size());
+  Q_FOREACH(const FileConflict& conflict, conflicts) {
+    QTreeWidgetItem* item = new QTreeWidgetItem();
+    item->setFlags(item->flags() | Qt::ItemIsEditable); // only NewNameColumn has an editor
+    item->setText(NameColumn, conflict.name);
+    item->setToolTip(NameColumn, conflict.destPath);
+    item->setText(SourceColumn, fileInfoText(conflict.srcMode, conflict.srcSize, conflict.srcMtime));
+    item->setToolTip(SourceColumn, conflict.srcPath);
+    item->setText(ExistingColumn, fileInfoText(conflict.destMode, conflict.destSize, conflict.destMtime));
+    if(!canOverwrite(conflict))
+      item->setToolTip(ActionColumn, tr("A folder and a file cannot replace each other"));
+    setAction(item, FM_FILE_OP_SKIP);
+    items.append(item);
+  }
+  // editing is only started by onItemDoubleClicked()
+  ui->conflicts->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  ui->conflicts->setItemDelegate(new NewNameDelegate(NewNameColumn, ui->conflicts));
+  ui->conflicts->addTopLevelItems(items);
+  ui->conflicts->resizeColumnToContents(NameColumn);
+
+  connect(ui->applyRule, SIGNAL(clicked(bool)), SLOT(onApplyRuleClicked()));
+  connect(ui->pattern, SIGNAL(returnPressed()), SLOT(onApplyRuleClicked()));
+  connect(ui->conflicts, SIGNAL(itemDoubleClicked(QTreeWidgetItem*,int)), SLOT(onItemDoubleClicked(QTreeWidgetItem*,int)));
+  connect(ui->conflicts, SIGNAL(itemChanged(QTreeWidgetItem*,int)), SLOT(onItemChanged(QTreeWidgetItem*,int)));
+}
+
+ConflictDialog::~ConflictDialog() {
+  delete ui;
+}
+
+// static
+QString ConflictDialog::fileInfoText(quint32 mode, qint64 size, qint64 mtime) {
+  QString time = QDateTime::fromTime_t(uint(mtime)).toString(Qt::DefaultLocaleShortDate);
+  if(S_ISDIR(mode))
+    return tr("Folder, %1").arg(time);
+  QString type;
+  if(S_ISREG(mode))
+    type = tr("File");
+  else if(S_ISLNK(mode))
+    type = tr("Link");
+  else
+    type = tr("Special file");
+  char sizeStr[64];
+  fm_file_size_to_str(sizeStr, sizeof(sizeStr), size, fm_config->si_unit);
+  return QString("%1, %2, %3")
+         .arg(type)
+         .arg(QString::fromUtf8(sizeStr))
+         .arg(time);
+}
+
+// the job refuses to replace a dir with a file or the reverse
+// static
+bool ConflictDialog::canOverwrite(const FileConflict& conflict) {
+  return S_ISDIR(conflict.srcMode) == S_ISDIR(conflict.destMode);
+}
+
+void ConflictDialog::setAction(QTreeWidgetItem* item, FmFileOpOption action) {
+  QString text;
+  switch(action) {
+  case FM_FILE_OP_OVERWRITE:
+    text = tr("Overwrite");
+    break;
+  case FM_FILE_OP_RENAME:
+    text = tr("Rename");
+    break;
+  default:
+    text = tr("Skip");
+    break;
+  }
+  item->setData(ActionColumn, Qt::UserRole, int(action));
+  item->setText(ActionColumn, text);
+}
+
+void ConflictDialog::onApplyRuleClicked() {
+  Rule rule = Rule(ui->action->currentIndex());
+  QString pattern = ui->pattern->text();
+  QRegExp regExp(pattern, Qt::CaseSensitive, QRegExp::Wildcard);
+  ui->conflicts->setUpdatesEnabled(false);
+  for(int i = 0; i < conflicts_.size(); ++i) {
+    const FileConflict& conflict = conflicts_.at(i);
+    if(!pattern.isEmpty() && !regExp.exactMatch(conflict.name))
+      continue;
+    QTreeWidgetItem* item = ui->conflicts->topLevelItem(i);
+    switch(rule) {
+    case RuleOverwrite:
+      if(canOverwrite(conflict))
+        setAction(item, FM_FILE_OP_OVERWRITE);
+      break;
+    case RuleOverwriteOlder:
+      if(canOverwrite(conflict))
+        setAction(item, conflict.destMtime < conflict.srcMtime ? FM_FILE_OP_OVERWRITE : FM_FILE_OP_SKIP);
+      break;
+    case RuleSkip:
+      setAction(item, FM_FILE_OP_SKIP);
+      break;
+    case RuleRename:
+      setAction(item, FM_FILE_OP_RENAME);
+      break;
+    }
+  }
+  ui->conflicts->setUpdatesEnabled(true);
+}
+
+void ConflictDialog::onItemDoubleClicked(QTreeWidgetItem* item, int column) {
+  if(item->text(NewNameColumn).isEmpty()) { // start with the old name
+    ui->conflicts->blockSignals(true);
+    item->setText(NewNameColumn, item->text(NameColumn));
+    ui->conflicts->blockSignals(false);
+  }
+  ui->conflicts->editItem(item, NewNameColumn);
+}
+
+void ConflictDialog::onItemChanged(QTreeWidgetItem* item, int column) {
+  if(column != NewNameColumn)
+    return;
+  QString newName = item->text(NewNameColumn);
+  // an empty name lets the job pick a free one
+  if(newName.contains('/') || newName == item->text(NameColumn))
+    item->setText(NewNameColumn, QString()); // this emits itemChanged() again
+  else if(!newName.isEmpty())
+    setAction(item, FM_FILE_OP_RENAME);
+}
+
+void ConflictDialog::accept() {
+  for(int i = 0; i < conflicts_.size(); ++i) {
+    QTreeWidgetItem* item = ui->conflicts->topLevelItem(i);
+    FileConflict& conflict = conflicts_[i];
+    conflict.action = FmFileOpOption(item->data(ActionColumn, Qt::UserRole).toInt());
+    conflict.newName = conflict.action == FM_FILE_OP_RENAME ? item->text(NewNameColumn) : QString();
+  }
+  QDialog::accept();
+}
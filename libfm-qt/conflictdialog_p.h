@@ -0,0 +1,85 @@
+/*
+
+    Copyright (C) 2013  Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+
+#ifndef FM_CONFLICTDIALOG_P_H
+#define FM_CONFLICTDIALOG_P_H
+
+#include <QDialog>
+#include <QList>
+#include "nativefileopsjob_p.h"
+
+namespace Ui {
+  class ConflictDialog;
+};
+
+class QTreeWidgetItem;
+
+namespace Fm {
+
+// Let the user decide what to do with all of the files held by a
+// FmNativeFileOpsJob because they exist in the destination.
+// Rules can be applied to all files or the ones matching a pattern,
+// and single files can be given new names.
+// A dir and a file never replace each other, so the overwrite rules skip them.
+class ConflictDialog : public QDialog {
+Q_OBJECT
+
+public:
+  explicit ConflictDialog(QList<FileConflict>& conflicts, QWidget* parent = 0);
+  virtual ~ConflictDialog();
+
+protected:
+  virtual void accept();
+
+private Q_SLOTS:
+  void onApplyRuleClicked();
+  void onItemDoubleClicked(QTreeWidgetItem* item, int column);
+  void onItemChanged(QTreeWidgetItem* item, int column);
+
+private:
+  enum Column {
+    NameColumn,
+    SourceColumn,
+    ExistingColumn,
+    ActionColumn,
+    NewNameColumn
+  };
+
+  // the items of the action combo box
+  enum Rule {
+    RuleOverwrite,
+    RuleOverwriteOlder,
+    RuleSkip,
+    RuleRename
+  };
+
+  void setAction(QTreeWidgetItem* item, FmFileOpOption action);
+  static QString fileInfoText(quint32 mode, qint64 size, qint64 mtime);
+  static bool canOverwrite(const FileConflict& conflict);
+
+private:
+  Ui::ConflictDialog* ui;
+  QList<FileConflict>& conflicts_;
+};
+
+}
+
+#endif // FM_CONFLICTDIALOG_P_H
@@ -0,0 +1,240 @@
+/*
+
+    Copyright (C) 2013  Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+
+#include "contentmatcher_p.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// files with a '\0' in their first bytes are treated as binary files like grep does
+#define BINARY_CHECK_SIZE   (8 * 1024)
+// plain strings are searched in chunks of this size
+#define READ_CHUNK_SIZE     (1024 * 1024)
+// regexps need the whole file as a QString, so larger files are never
+// searched with them, even if the size is not limited.
+#define MAX_REGEXP_FILE_SIZE  (256 * 1024 * 1024)
+
+namespace Fm {
+
+static inline char asciiLower(char c) {
+  return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+static inline char asciiUpper(char c) {
+  return (c >= 'a' && c <= 'z') ? c - ('a' - 'A') : c;
+}
+
+ContentMatcher::ContentMatcher(const QString& pattern, bool caseInsensitive, bool regExp, qint64 maxFileSize):
+  pattern_(pattern.toUtf8()),
+  caseInsensitive_(caseInsensitive),
+  useRegExp_(regExp),
+  maxFileSize_(maxFileSize) {
+
+  if(caseInsensitive_ && !useRegExp_) {
+    // non-ASCII letters cannot be folded byte by byte, so QRegExp handles them.
+    for(int i = 0; i < pattern_.size(); ++i) {
+      if(pattern_[i] & 0x80) {
+        useRegExp_ = true;
+        break;
+      }
+    }
+  }
+  if(useRegExp_) {
+    re_ = QRegExp(pattern, caseInsensitive_ ? Qt::CaseInsensitive : Qt::CaseSensitive,
+                  regExp ? QRegExp::RegExp2 : QRegExp::FixedString);
+  }
+  else if(caseInsensitive_) {
+    for(int i = 0; i < pattern_.size(); ++i)
+      pattern_[i] = asciiLower(pattern_[i]);
+  }
+}
+
+// read len bytes at offset unless the end of the file is reached first.
+// returns the number of bytes read, or -1 on errors.
+static ssize_t readAt(int fd, char* buf, size_t len, off_t offset) {
+  size_t done = 0;
+  while(done < len) {
+    ssize_t n = pread(fd, buf + done, len - done, offset + done);
+    if(n == 0)
+      break;
+    if(n < 0) {
+      if(errno == EINTR)
+        continue;
+      return -1;
+    }
+    done += n;
+  }
+  return done;
+}
+
+int ContentMatcher::countMatches(const char* path) const {
+  // O_NONBLOCK prevents blocking on fifos before we know the file type
+  int fd = open(path, O_RDONLY|O_NONBLOCK|O_NOCTTY|O_CLOEXEC);
+  if(fd < 0)
+    return -1;
+  qint64 maxSize = maxFileSize_;
+  if(useRegExp_ && (maxSize < 0 || maxSize > MAX_REGEXP_FILE_SIZE))
+    maxSize = MAX_REGEXP_FILE_SIZE;
+  struct stat st;
+  if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (maxSize >= 0 && st.st_size > maxSize)) {
+    close(fd);
+    return -1;
+  }
+  if(st.st_size == 0) {
+    close(fd);
+    return 0;
+  }
+#ifdef POSIX_FADV_SEQUENTIAL
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL); // let the kernel read ahead
+#endif
+
+  // the files are read rather than mapped into memory. a mapped file
+  // truncated by someone else while we're reading it would crash us with SIGBUS.
+  int count = useRegExp_ ? countRegExp(fd, st.st_size) : countString(fd);
+  close(fd);
+  return count;
+}
+
+// static
+bool ContentMatcher::isBinary(const char* data, const char* end) {
+  size_t len = qMin(size_t(end - data), size_t(BINARY_CHECK_SIZE));
+  return memchr(data, '\0', len) != NULL;
+}
+
+int ContentMatcher::countString(int fd) const {
+  int len = pattern_.size();
+  // a match may cross the boundary of two chunks, so the last len - 1
+  // bytes of a chunk are kept and searched again with the next one.
+  int carry = len - 1;
+  QByteArray buffer;
+  buffer.resize(carry + READ_CHUNK_SIZE);
+  char* buf = buffer.data();
+  int count = 0;
+  int kept = 0; // bytes kept from the last chunk
+  int skip = 0; // matches cannot start before this since they'd overlap the last one
+  off_t offset = 0;
+  for(;;) {
+    ssize_t n = readAt(fd, buf + kept, READ_CHUNK_SIZE, offset);
+    if(n < 0 || (offset == 0 && isBinary(buf, buf + n)))
+      return -1;
+    if(n == 0)
+      break;
+    offset += n;
+    const char* end = buf + kept + n;
+    const char* p = buf + skip;
+    const char* lastEnd = p; // end of the last match
+    while((p = find(p, end))) {
+      if(count < INT_MAX)
+        ++count;
+      p += len; // count matches without overlapping
+      lastEnd = p;
+    }
+    if(n < READ_CHUNK_SIZE) // end of the file
+      break;
+    kept = qMin(carry, int(end - buf));
+    const char* tail = end - kept;
+    skip = qMax(0, int(lastEnd - tail));
+    memmove(buf, tail, kept);
+  }
+  return count;
+}
+
+int ContentMatcher::countRegExp(int fd, qint64 size) const {
+  // size is limited by MAX_REGEXP_FILE_SIZE, so it fits in an int
+  QByteArray data;
+  data.resize(int(size));
+  ssize_t n = readAt(fd, data.data(), data.size(), 0);
+  if(n < 0)
+    return -1;
+  data.resize(int(n)); // the file may be truncated after fstat()
+  if(isBinary(data.constData(), data.constData() + data.size()))
+    return -1;
+  QString text = QString::fromUtf8(data.constData(), data.size());
+  data.clear(); // free the memory before matching
+  QRegExp re = re_;
+  int count = 0;
+  int pos = 0;
+  while((pos = re.indexIn(text, pos)) >= 0) {
+    ++count;
+    pos += qMax(re.matchedLength(), 1);
+  }
+  return count;
+}
+
+inline bool ContentMatcher::equalAt(const char* p) const {
+  int len = pattern_.size();
+  if(!caseInsensitive_)
+    return memcmp(p, pattern_.constData(), len) == 0;
+  const char* pattern = pattern_.constData();
+  for(int i = 0; i < len; ++i) {
+    if(asciiLower(p[i]) != pattern[i])
+      return false;
+  }
+  return true;
+}
+
+// find the next match in [p, end), or return NULL
+const char* ContentMatcher::find(const char* p, const char* end) const {
+  int len = pattern_.size();
+  if(end - p < len)
+    return NULL;
+  const char* last = end - len; // the last position a match can start
+
+#ifdef __SSE2__
+  // compare the first and the last bytes of the pattern at 16 positions at once,
+  // and only compare the whole pattern at the positions where both are equal.
+  char first = pattern_[0];
+  char lastByte = pattern_[len - 1];
+  const __m128i first0 = _mm_set1_epi8(first);
+  const __m128i first1 = _mm_set1_epi8(caseInsensitive_ ? asciiUpper(first) : first);
+  const __m128i last0 = _mm_set1_epi8(lastByte);
+  const __m128i last1 = _mm_set1_epi8(caseInsensitive_ ? asciiUpper(lastByte) : lastByte);
+  for(; p + 15 <= last; p += 16) {
+    __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + len - 1));
+    __m128i eqFirst = _mm_or_si128(_mm_cmpeq_epi8(blockFirst, first0), _mm_cmpeq_epi8(blockFirst, first1));
+    __m128i eqLast = _mm_or_si128(_mm_cmpeq_epi8(blockLast, last0), _mm_cmpeq_epi8(blockLast, last1));
+    unsigned int mask = _mm_movemask_epi8(_mm_and_si128(eqFirst, eqLast));
+    while(mask) {
+      int bit = __builtin_ctz(mask);
+      if(equalAt(p + bit))
+        return p + bit;
+      mask &= mask - 1;
+    }
+  }
+#endif
+
+  // the rest of the data, or all of it without SSE2
+  for(; p <= last; ++p) {
+    if(equalAt(p))
+      return p;
+  }
+  return NULL;
+}
+
+}
@@ -0,0 +1,62 @@
+/*
+
+    Copyright (C) 2013  Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+
+#ifndef FM_CONTENTMATCHER_P_H
+#define FM_CONTENTMATCHER_P_H
+
+#include <QString>
+#include <QByteArray>
+#include <QRegExp>
+
+namespace Fm {
+
+// Counts the occurrences of a text in files for FileSearch.
+// Plain strings are searched in chunks read with pread(), and found with
+// SSE2 by comparing the first and the last bytes at 16 positions at once.
+// Regexps need the whole file in memory, so their file size is always limited.
+// It's shared by the worker threads, so it's not changed after creation.
+class ContentMatcher {
+public:
+  ContentMatcher(const QString& pattern, bool caseInsensitive, bool regExp, qint64 maxFileSize);
+
+  // number of the matches in the file, 0 if there's none.
+  // -1 if the file is not searched since it's not a regular file,
+  // it's larger than the size limit, or it looks like a binary file.
+  int countMatches(const char* path) const;
+
+private:
+  int countString(int fd) const;
+  int countRegExp(int fd, qint64 size) const;
+  const char* find(const char* p, const char* end) const;
+  bool equalAt(const char* p) const;
+  static bool isBinary(const char* data, const char* end);
+
+private:
+  QByteArray pattern_; // UTF-8, lower case if caseInsensitive_ is set
+  bool caseInsensitive_; // only ASCII letters are folded for plain strings
+  bool useRegExp_;
+  QRegExp re_; // copied before use since QRegExp cannot be shared among threads
+  qint64 maxFileSize_;
+};
+
+}
+
+#endif // FM_CONTENTMATCHER_P_H
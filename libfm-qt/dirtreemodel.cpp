@@ -24,10 +24,33 @@
 namespace Fm {
 
 DirTreeModel::DirTreeModel(QObject* parent):
+  QAbstractItemModel(parent),
   showHidden_(false) {
 }
 
 DirTreeModel::~DirTreeModel() {
+  Q_FOREACH(FmFileInfoJob* job, rootsJobs_) {
+    g_signal_handlers_disconnect_by_func(job, (gpointer)onRootsJobFinished, this);
+    fm_job_cancel(FM_JOB(job));
+    g_object_unref(job);
+  }
+}
+
+// the query can block on slow file systems, so the roots are added when it's done
+void DirTreeModel::addRoots(FmPathList* paths) {
+  FmFileInfoJob* job = fm_file_info_job_new(paths, FM_FILE_INFO_JOB_NONE);
+  rootsJobs_.append(job);
+  g_signal_connect(job, "finished", G_CALLBACK(onRootsJobFinished), this);
+  fm_job_run_async(FM_JOB(job));
+}
+
+/*static*/ void DirTreeModel::onRootsJobFinished(FmFileInfoJob* job, DirTreeModel* pThis) {
+  for(GList* l = fm_file_info_list_peek_head_link(job->file_infos); l; l = l->next) {
+    FmFileInfo* fi = FM_FILE_INFO(l->data);
+    pThis->addRoot(fi);
+  }
+  pThis->rootsJobs_.removeOne(job);
+  g_object_unref(job);
 }
 
 // QAbstractItemModel implementation
@@ -159,13 +182,16 @@ DirTreeModelItem* DirTreeModel::itemFromPath(FmPath* path) const {
 void DirTreeModel::loadRow(const QModelIndex& index) {
   DirTreeModelItem* item = itemFromIndex(index);
   Q_ASSERT(item);
-  if(item && !item->isPlaceHolder())
+  if(item && !item->isPlaceHolder()) {
+    ++item->loadRefs_;
     item->loadFolder();
+  }
 }
 
+// the row is only unloaded after all of the views expanding it collapse it
 void DirTreeModel::unloadRow(const QModelIndex& index) {
   DirTreeModelItem* item = itemFromIndex(index);
-  if(item && !item->isPlaceHolder())
+  if(item && !item->isPlaceHolder() && item->loadRefs_ > 0 && --item->loadRefs_ == 0)
     item->unloadFolder();
 }
 
@@ -49,6 +49,8 @@ public:
   ~DirTreeModel();
 
   QModelIndex addRoot(FmFileInfo* root);
+  // query the info of the paths asynchronously and add them as roots
+  void addRoots(FmPathList* paths);
   void loadRow(const QModelIndex& index);
   void unloadRow(const QModelIndex& index);
 
@@ -81,9 +83,13 @@ private:
 Q_SIGNALS:
   void rowLoaded(const QModelIndex& index);
 
+private:
+  static void onRootsJobFinished(FmFileInfoJob* job, DirTreeModel* pThis);
+
 private:
   bool showHidden_;
   QList<DirTreeModelItem*> rootItems_;
+  QList<FmFileInfoJob*> rootsJobs_;
 };
 }
 
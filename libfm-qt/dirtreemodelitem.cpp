@@ -30,6 +30,7 @@ DirTreeModelItem::DirTreeModelItem():
   folder_(NULL),
   expanded_(false),
   loaded_(false),
+  loadRefs_(0),
   fileInfo_(NULL),
   placeHolderChild_(NULL),
   parent_(NULL) {
@@ -40,6 +41,7 @@ DirTreeModelItem::DirTreeModelItem(FmFileInfo* info, DirTreeModel* model, DirTre
   folder_(NULL),
   expanded_(false),
   loaded_(false),
+  loadRefs_(0),
   fileInfo_(fm_file_info_ref(info)),
   displayName_(QString::fromUtf8(fm_file_info_get_disp_name(info))),
   icon_(IconTheme::icon(fm_file_info_get_icon(info))),
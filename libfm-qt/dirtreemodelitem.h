@@ -72,6 +72,7 @@ private:
   QIcon icon_;
   bool expanded_;
   bool loaded_;
+  int loadRefs_; // number of the views expanding the item since the model can be shared
   DirTreeModelItem* parent_;
   DirTreeModelItem* placeHolderChild_;
   QList<DirTreeModelItem*> children_;
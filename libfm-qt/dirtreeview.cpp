@@ -41,10 +41,25 @@ DirTreeView::DirTreeView(QWidget* parent):
 }
 
 DirTreeView::~DirTreeView() {
+  // the model can be shared with other views, so let it unload
+  // the rows which are only expanded by this view
+  if(qobject_cast<DirTreeModel*>(model()))
+    releaseExpandedRows(QModelIndex());
   if(currentPath_)
     fm_path_unref(currentPath_);
 }
 
+void DirTreeView::releaseExpandedRows(const QModelIndex& parent) {
+  DirTreeModel* treeModel = static_cast<DirTreeModel*>(model());
+  for(int row = treeModel->rowCount(parent) - 1; row >= 0; --row) {
+    QModelIndex index = treeModel->index(row, 0, parent);
+    if(isExpanded(index)) {
+      releaseExpandedRows(index); // children first since unloading a row removes them
+      treeModel->unloadRow(index);
+    }
+  }
+}
+
 void DirTreeView::cancelPendingChdir() {
   if(!pathsToExpand_.isEmpty()) {
     pathsToExpand_.clear();
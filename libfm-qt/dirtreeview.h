@@ -62,6 +62,7 @@ protected:
 private:
   void cancelPendingChdir();
   void expandPendingPath();
+  void releaseExpandedRows(const QModelIndex& parent);
 
 Q_SIGNALS:
   void chdirRequested(int type, FmPath* path);
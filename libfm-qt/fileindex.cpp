@@ -0,0 +1,499 @@
+/*
+
+    Copyright (C) 2013  Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+
+#include "fileindex.h"
+#include <QThreadPool>
+#include <QRunnable>
+#include <QMutexLocker>
+#include <QSocketNotifier>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDataStream>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#define INDEX_FILE_MAGIC    0x464d4958 // "FMIX"
+#define INDEX_FILE_VERSION  1
+// delay before the changed dirs are read again, so a burst of changes is handled at once
+#define CHANGE_DELAY        (2 * 1000)
+// delay before the index is saved after it's changed
+#define SAVE_DELAY          (60 * 1000)
+// the timer interval is an int in milliseconds (about 24 days)
+#define MAX_RESCAN_INTERVAL (INT_MAX / 1000)
+// max number of inotify watches used by the index. it's also limited to
+// a quarter of max_user_watches, so other programs still get enough of them.
+#define MAX_WATCHES         8192
+
+namespace Fm {
+
+FileIndex* FileIndex::defaultIndex_ = NULL;
+
+static inline QByteArray childPath(const QByteArray& dir, const char* name) {
+  return dir.endsWith('/') ? dir + name : dir + '/' + name;
+}
+
+// read the requested dirs in the worker thread
+class FileIndex::ScanTask : public QRunnable {
+public:
+  ScanTask(FileIndex* index, const QList<ScanRequest>& requests):
+    index_(index),
+    requests_(requests) {
+  }
+
+  virtual void run() {
+    ScanResult* result = new ScanResult();
+    index_->scan(requests_, result);
+    {
+      QMutexLocker locker(&index_->lock_);
+      index_->results_.append(result);
+    }
+    QMetaObject::invokeMethod(index_, "onScanFinished", Qt::QueuedConnection);
+  }
+
+private:
+  FileIndex* index_;
+  QList<ScanRequest> requests_;
+};
+
+FileIndex::FileIndex(const QString& fileName, QObject* parent):
+  QObject(parent),
+  fileName_(fileName),
+  rescanInterval_(60 * 60),
+  pool_(new QThreadPool()),
+  cancelled_(0),
+  fullScanQueued_(false),
+  dirty_(false),
+  inotifyFd_(-1),
+  inotifyNotifier_(NULL),
+  maxWatches_(0) {
+
+  pool_->setMaxThreadCount(1);
+  rescanTimer_.setInterval(rescanInterval_ * 1000);
+  connect(&rescanTimer_, SIGNAL(timeout()), SLOT(rescan()));
+  changeTimer_.setSingleShot(true);
+  changeTimer_.setInterval(CHANGE_DELAY);
+  connect(&changeTimer_, SIGNAL(timeout()), SLOT(updateChangedDirs()));
+  saveTimer_.setSingleShot(true);
+  saveTimer_.setInterval(SAVE_DELAY);
+  connect(&saveTimer_, SIGNAL(timeout()), SLOT(save()));
+}
+
+FileIndex::~FileIndex() {
+  if(defaultIndex_ == this)
+    defaultIndex_ = NULL;
+  cancelled_.fetchAndStoreOrdered(1);
+  pool_->waitForDone();
+  delete pool_;
+  qDeleteAll(results_);
+  if(dirty_)
+    save();
+  if(inotifyNotifier_)
+    delete inotifyNotifier_;
+  if(inotifyFd_ >= 0)
+    close(inotifyFd_);
+}
+
+void FileIndex::setRoots(const QStringList& roots) {
+  roots_ = roots;
+  rootPaths_.clear();
+  Q_FOREACH(const QString& root, roots) {
+    QString realPath = QFileInfo(root).canonicalFilePath();
+    if(!realPath.isEmpty())
+      rootPaths_.append(QFile::encodeName(realPath));
+  }
+}
+
+void FileIndex::setRescanInterval(int seconds) {
+  seconds = qBound(0, seconds, MAX_RESCAN_INTERVAL);
+  rescanInterval_ = seconds;
+  if(seconds > 0) {
+    rescanTimer_.setInterval(seconds * 1000);
+    if(inotifyFd_ >= 0 || !dirs_.isEmpty()) // started
+      rescanTimer_.start();
+  }
+  else
+    rescanTimer_.stop();
+}
+
+void FileIndex::start() {
+#ifdef __linux__
+  if(inotifyFd_ < 0) {
+    inotifyFd_ = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+    if(inotifyFd_ >= 0) {
+      inotifyNotifier_ = new QSocketNotifier(inotifyFd_, QSocketNotifier::Read);
+      connect(inotifyNotifier_, SIGNAL(activated(int)), SLOT(onInotifyEvent()));
+      maxWatches_ = MAX_WATCHES;
+      QFile file("/proc/sys/fs/inotify/max_user_watches");
+      if(file.open(QIODevice::ReadOnly)) {
+        int userWatches = file.readAll().trimmed().toInt();
+        if(userWatches > 0)
+          maxWatches_ = qMin(maxWatches_, userWatches / 4);
+      }
+    }
+  }
+#endif
+  // the saved index can be used right away, and it's brought up to date in the background.
+  load();
+  rescan();
+  if(rescanInterval_ > 0)
+    rescanTimer_.start();
+}
+
+bool FileIndex::covers(const QByteArray& path) const {
+  Q_FOREACH(const QByteArray& root, rootPaths_) {
+    if(path == root || path.startsWith(root.endsWith('/') ? root : root + '/'))
+      return dirs_.contains(path); // hidden dirs are not indexed
+  }
+  return false;
+}
+
+void FileIndex::rescan() {
+  if(fullScanQueued_ || rootPaths_.isEmpty())
+    return;
+  QList<ScanRequest> requests;
+  Q_FOREACH(const QByteArray& root, rootPaths_) {
+    ScanRequest request;
+    request.path = root;
+    request.recursive = true;
+    requests.append(request);
+  }
+  fullScanQueued_ = true;
+  queueScan(requests);
+}
+
+void FileIndex::queueScan(const QList<ScanRequest>& requests) {
+  pool_->start(new ScanTask(this, requests));
+}
+
+// called from the worker thread
+void FileIndex::scan(const QList<ScanRequest>& requests, ScanResult* result) {
+  result->requests = requests;
+  Q_FOREACH(const ScanRequest& request, requests) {
+    if(cancelled_.fetchAndAddOrdered(0))
+      break;
+    scanDir(request.path, request.recursive, result->dirs);
+  }
+}
+
+// called from the worker thread.
+// the dirs are read breadth first, so the shallow ones get the watches first.
+void FileIndex::scanDir(const QByteArray& path, bool recursive, DirMap& dirs) {
+  QList<QByteArray> queue;
+  queue.append(path);
+  while(!queue.isEmpty() && !cancelled_.fetchAndAddOrdered(0)) {
+    QByteArray dirPath = queue.takeFirst();
+    DIR* dir = opendir(dirPath.constData());
+    if(!dir)
+      continue;
+    int fd = dirfd(dir);
+    Dir& record = dirs[dirPath];
+    record.watch = addWatch(dirPath);
+
+    struct dirent* ent;
+    while(!cancelled_.fetchAndAddOrdered(0) && (ent = readdir(dir))) {
+      const char* name = ent->d_name;
+      if(name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+        continue;
+      struct stat st;
+      if(fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+        continue;
+      Entry entry;
+      entry.nameOffset = record.names.size();
+      entry.flags = S_ISDIR(st.st_mode) ? EntryIsDir : 0;
+      entry.size = st.st_size;
+      entry.mtime = st.st_mtime;
+      record.names.append(name);
+      record.names.append('\0');
+      record.entries.append(entry);
+      // the content of hidden dirs is not indexed. they're mostly caches changing all the time.
+      if(recursive && S_ISDIR(st.st_mode) && name[0] != '.')
+        queue.append(childPath(dirPath, name));
+    }
+    closedir(dir);
+    record.names.squeeze();
+    record.entries.squeeze();
+  }
+}
+
+// watch the dir with inotify unless the limit is reached.
+// returns the watch descriptor, or -1. called from the worker thread.
+int FileIndex::addWatch(const QByteArray& path) {
+#ifdef __linux__
+  if(inotifyFd_ < 0)
+    return -1;
+  QMutexLocker locker(&lock_);
+  // a dir already watched gets the same descriptor again, so it does not count.
+  if(!watchedDirs_.contains(path) && watchedDirs_.size() >= maxWatches_)
+    return -1;
+  int wd = inotify_add_watch(inotifyFd_, path.constData(),
+                             IN_CREATE|IN_DELETE|IN_MOVED_FROM|IN_MOVED_TO|IN_CLOSE_WRITE|IN_ONLYDIR|IN_DONT_FOLLOW);
+  if(wd >= 0)
+    watchedDirs_.insert(path, wd);
+  return wd;
+#else
+  return -1;
+#endif
+}
+
+void FileIndex::onScanFinished() {
+  QList<ScanResult*> results;
+  {
+    QMutexLocker locker(&lock_);
+    results = results_;
+    results_.clear();
+  }
+  Q_FOREACH(ScanResult* result, results) {
+    if(!cancelled_.fetchAndAddOrdered(0))
+      applyScan(result);
+    delete result;
+  }
+  dirty_ = true;
+  if(!saveTimer_.isActive())
+    saveTimer_.start();
+  Q_EMIT updated();
+}
+
+void FileIndex::applyScan(ScanResult* result) {
+  // the watches of the dirs read again are reused, so they should not be removed
+  QSet<int> newWatches;
+  for(DirMap::const_iterator it = result->dirs.constBegin(); it != result->dirs.constEnd(); ++it) {
+    if(it.value().watch >= 0)
+      newWatches.insert(it.value().watch);
+  }
+
+  QList<ScanRequest> moreRequests;
+  Q_FOREACH(const ScanRequest& request, result->requests) {
+    if(request.recursive) {
+      // replace the whole sub tree
+      removeDir(request.path, newWatches);
+      DirMap::const_iterator it = result->dirs.constFind(request.path);
+      if(it != result->dirs.constEnd())
+        dirs_.insert(it.key(), it.value());
+      QByteArray prefix = request.path.endsWith('/') ? request.path : request.path + '/';
+      for(it = result->dirs.lowerBound(prefix); it != result->dirs.constEnd() && it.key().startsWith(prefix); ++it)
+        dirs_.insert(it.key(), it.value());
+      if(rootPaths_.contains(request.path))
+        fullScanQueued_ = false;
+    }
+    else {
+      // replace one dir, and update the sub dirs added or removed since it's last read
+      DirMap::iterator old = dirs_.find(request.path);
+      DirMap::const_iterator dir = result->dirs.constFind(request.path);
+      QSet<QByteArray> oldSubDirs;
+      if(old != dirs_.end()) {
+        const Dir& oldDir = old.value();
+        Q_FOREACH(const Entry& entry, oldDir.entries) {
+          if((entry.flags & EntryIsDir) && oldDir.name(entry)[0] != '.')
+            oldSubDirs.insert(childPath(request.path, oldDir.name(entry)));
+        }
+        removeWatch(old.value(), newWatches);
+      }
+      if(dir == result->dirs.constEnd()) { // the dir is gone
+        removeDir(request.path, newWatches);
+        continue;
+      }
+      dirs_.insert(request.path, dir.value());
+      const Dir& newDir = dir.value();
+      Q_FOREACH(const Entry& entry, newDir.entries) {
+        if((entry.flags & EntryIsDir) && newDir.name(entry)[0] != '.') {
+          QByteArray subDir = childPath(request.path, newDir.name(entry));
+          if(!oldSubDirs.remove(subDir) && !dirs_.contains(subDir)) {
+            ScanRequest more;
+            more.path = subDir;
+            more.recursive = true;
+            moreRequests.append(more);
+          }
+        }
+      }
+      Q_FOREACH(const QByteArray& subDir, oldSubDirs)
+        removeDir(subDir, newWatches);
+    }
+  }
+
+  for(DirMap::const_iterator it = result->dirs.constBegin(); it != result->dirs.constEnd(); ++it) {
+    if(it.value().watch >= 0)
+      watches_.insert(it.value().watch, it.key());
+  }
+  // read the new sub dirs found
+  if(!moreRequests.isEmpty())
+    queueScan(moreRequests);
+}
+
+// remove the dir and its sub dirs from the index.
+// the watches in keepWatches are still used by the dirs just read.
+void FileIndex::removeDir(const QByteArray& path, const QSet<int>& keepWatches) {
+  DirMap::iterator it = dirs_.find(path);
+  if(it != dirs_.end()) {
+    removeWatch(it.value(), keepWatches);
+    dirs_.erase(it);
+  }
+  QByteArray prefix = path.endsWith('/') ? path : path + '/';
+  it = dirs_.lowerBound(prefix);
+  while(it != dirs_.end() && it.key().startsWith(prefix)) {
+    removeWatch(it.value(), keepWatches);
+    it = dirs_.erase(it);
+  }
+}
+
+void FileIndex::removeWatch(Dir& dir, const QSet<int>& keepWatches) {
+#ifdef __linux__
+  if(dir.watch >= 0 && inotifyFd_ >= 0 && !keepWatches.contains(dir.watch)) {
+    inotify_rm_watch(inotifyFd_, dir.watch);
+    QHash<int, QByteArray>::iterator it = watches_.find(dir.watch);
+    if(it != watches_.end()) {
+      QMutexLocker locker(&lock_);
+      // the dir may be watched again with another descriptor by now
+      QHash<QByteArray, int>::iterator watched = watchedDirs_.find(it.value());
+      if(watched != watchedDirs_.end() && watched.value() == dir.watch)
+        watchedDirs_.erase(watched);
+      watches_.erase(it);
+    }
+  }
+#endif
+  dir.watch = -1;
+}
+
+void FileIndex::onInotifyEvent() {
+#ifdef __linux__
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  ssize_t len;
+  while((len = read(inotifyFd_, buf, sizeof(buf))) > 0) {
+    for(char* p = buf; p < buf + len;) {
+      struct inotify_event* event = reinterpret_cast<struct inotify_event*>(p);
+      p += sizeof(struct inotify_event) + event->len;
+      if(event->mask & IN_Q_OVERFLOW) { // events are lost, read everything again
+        rescan();
+        continue;
+      }
+      if(event->mask & IN_IGNORED) { // the watch is removed
+        QHash<int, QByteArray>::iterator it = watches_.find(event->wd);
+        if(it != watches_.end()) {
+          QMutexLocker locker(&lock_);
+          QHash<QByteArray, int>::iterator watched = watchedDirs_.find(it.value());
+          if(watched != watchedDirs_.end() && watched.value() == event->wd)
+            watchedDirs_.erase(watched);
+          watches_.erase(it);
+        }
+        continue;
+      }
+      QHash<int, QByteArray>::const_iterator it = watches_.constFind(event->wd);
+      if(it != watches_.constEnd())
+        changedDirs_.insert(it.value());
+    }
+  }
+  if(!changedDirs_.isEmpty() && !changeTimer_.isActive())
+    changeTimer_.start();
+#endif
+}
+
+void FileIndex::updateChangedDirs() {
+  QList<ScanRequest> requests;
+  Q_FOREACH(const QByteArray& path, changedDirs_) {
+    ScanRequest request;
+    request.path = path;
+    request.recursive = false;
+    requests.append(request);
+  }
+  changedDirs_.clear();
+  if(!requests.isEmpty())
+    queueScan(requests);
+}
+
+bool FileIndex::load() {
+  QFile file(fileName_);
+  if(!file.open(QIODevice::ReadOnly))
+    return false;
+  QDataStream in(&file);
+  quint32 magic, version;
+  QStringList roots;
+  quint32 n_dirs;
+  in >> magic >> version;
+  if(magic != INDEX_FILE_MAGIC || version != INDEX_FILE_VERSION)
+    return false;
+  in >> roots >> n_dirs;
+  if(roots != roots_) // the roots are changed, the old index is useless
+    return false;
+
+  DirMap dirs;
+  for(quint32 i = 0; i < n_dirs && in.status() == QDataStream::Ok; ++i) {
+    QByteArray path, entries;
+    Dir dir;
+    in >> path >> dir.names >> entries;
+    int n_entries = entries.size() / sizeof(Entry);
+    dir.entries.resize(n_entries);
+    memcpy(dir.entries.data(), entries.constData(), n_entries * sizeof(Entry));
+    dir.watch = -1;
+    // don't trust a broken file. a bad offset would make Dir::name() read out of bounds.
+    bool valid = (entries.size() % sizeof(Entry) == 0)
+                 && (dir.names.isEmpty() || dir.names.endsWith('\0'));
+    for(int j = 0; valid && j < n_entries; ++j) {
+      if(dir.entries[j].nameOffset >= quint32(dir.names.size()))
+        valid = false;
+    }
+    if(valid) // the dir is read again by the rescan
+      dirs.insert(path, dir);
+  }
+  if(in.status() != QDataStream::Ok)
+    return false;
+  dirs_ = dirs;
+  dirty_ = false;
+  return true;
+}
+
+bool FileIndex::save() {
+  saveTimer_.stop();
+  QDir().mkpath(QFileInfo(fileName_).absolutePath());
+  // write to a temp file and replace the old one, so a crash does not leave a broken index
+  QString tmpName = fileName_ + ".tmp";
+  QFile file(tmpName);
+  if(!file.open(QIODevice::WriteOnly|QIODevice::Truncate))
+    return false;
+  QDataStream out(&file);
+  out << quint32(INDEX_FILE_MAGIC) << quint32(INDEX_FILE_VERSION);
+  out << roots_ << quint32(dirs_.size());
+  for(DirMap::const_iterator it = dirs_.constBegin(); it != dirs_.constEnd(); ++it) {
+    const Dir& dir = it.value();
+    // entries are saved as they're in memory, so loading them is a single copy
+    QByteArray entries = QByteArray::fromRawData(reinterpret_cast<const char*>(dir.entries.constData()),
+                                                 dir.entries.size() * sizeof(Entry));
+    out << it.key() << dir.names << entries;
+  }
+  file.close();
+  if(out.status() != QDataStream::Ok || rename(QFile::encodeName(tmpName).constData(), QFile::encodeName(fileName_).constData()) != 0) {
+    QFile::remove(tmpName);
+    return false;
+  }
+  dirty_ = false;
+  return true;
+}
+
+}
@@ -0,0 +1,185 @@
+/*
+
+    Copyright (C) 2013  Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+
+#ifndef FM_FILEINDEX_H
+#define FM_FILEINDEX_H
+
+#include "libfmqtglobals.h"
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QList>
+#include <QVector>
+#include <QMap>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QTimer>
+
+class QThreadPool;
+class QSocketNotifier;
+
+namespace Fm {
+
+// A persistent index of the file names under some root dirs, so
+// searching them by name does not need to read the dirs again.
+// It's loaded from and saved to a compact binary file. The dirs are
+// rescanned in a worker thread periodically, and on Linux, changed
+// dirs are also updated shortly after the changes with inotify.
+// inotify watches are shared by all programs of the user, so only a
+// limited number of dirs are watched, the shallow ones first. The
+// others are only updated by the periodic rescans.
+// All methods should be called from the main thread.
+class LIBFM_QT_API FileIndex : public QObject {
+Q_OBJECT
+public:
+  enum {
+    EntryIsDir = 1 << 0
+  };
+
+  struct Entry {
+    quint32 nameOffset; // offset of the name in Dir::names
+    quint32 flags;
+    qint64 size;
+    qint64 mtime;
+  };
+
+  // the content of a dir. the names are stored in one block
+  // separated by '\0' to keep the index small.
+  struct Dir {
+    QByteArray names;
+    QVector<Entry> entries;
+    int watch; // inotify watch descriptor, or -1
+
+    const char* name(const Entry& entry) const {
+      return names.constData() + entry.nameOffset;
+    }
+  };
+
+  // dirs sorted by their local paths, so all the dirs under a dir are found
+  // in a range starting from it. together they form a trie of the paths.
+  typedef QMap<QByteArray, Dir> DirMap;
+
+public:
+  explicit FileIndex(const QString& fileName, QObject* parent = 0);
+  virtual ~FileIndex();
+
+  // the index to use for file searches, or NULL
+  static FileIndex* defaultIndex() {
+    return defaultIndex_;
+  }
+  static void setDefaultIndex(FileIndex* index) {
+    defaultIndex_ = index;
+  }
+
+  QStringList roots() const {
+    return roots_;
+  }
+  // changing the roots takes effect when the index is started
+  void setRoots(const QStringList& roots);
+
+  // in seconds, 0 to disable periodic rescans.
+  // longer intervals than the max of QTimer (about 24 days) are clamped.
+  int rescanInterval() const {
+    return rescanInterval_;
+  }
+  void setRescanInterval(int seconds);
+
+  // load the saved index and start updating it
+  void start();
+
+  // the dir is under one of the roots and its content is already indexed
+  bool covers(const QByteArray& path) const;
+
+  const DirMap& dirs() const {
+    return dirs_;
+  }
+
+Q_SIGNALS:
+  // a scan of the dirs has been applied to the index
+  void updated();
+
+public Q_SLOTS:
+  void rescan();
+  bool save();
+
+private Q_SLOTS:
+  void onScanFinished();
+  void onInotifyEvent();
+  void updateChangedDirs();
+
+private:
+  class ScanTask;
+  friend class ScanTask;
+
+  struct ScanRequest {
+    QByteArray path;
+    bool recursive;
+  };
+
+  struct ScanResult {
+    QList<ScanRequest> requests;
+    DirMap dirs;
+  };
+
+  bool load();
+  void queueScan(const QList<ScanRequest>& requests);
+  void scan(const QList<ScanRequest>& requests, ScanResult* result);
+  void scanDir(const QByteArray& path, bool recursive, DirMap& dirs);
+  int addWatch(const QByteArray& path);
+  void applyScan(ScanResult* result);
+  void removeDir(const QByteArray& path, const QSet<int>& keepWatches);
+  void removeWatch(Dir& dir, const QSet<int>& keepWatches);
+
+private:
+  static FileIndex* defaultIndex_;
+
+  QString fileName_;
+  QStringList roots_;
+  QList<QByteArray> rootPaths_; // local paths of the roots
+  int rescanInterval_;
+  DirMap dirs_;
+  QThreadPool* pool_; // runs one scan at a time so they're applied in order
+  QMutex lock_;
+  QList<ScanResult*> results_; // finished scans not yet applied
+  QAtomicInt cancelled_;
+  bool fullScanQueued_;
+  QTimer rescanTimer_;
+  QTimer changeTimer_;
+  QTimer saveTimer_;
+  bool dirty_; // changed since saved
+
+  // inotify
+  int inotifyFd_;
+  QSocketNotifier* inotifyNotifier_;
+  QHash<int, QByteArray> watches_; // watch descriptor => dir path
+  // dir path => watch descriptor. watches are added by the worker thread and
+  // removed by the main thread, so it's guarded by lock_.
+  QHash<QByteArray, int> watchedDirs_;
+  int maxWatches_;
+  QSet<QByteArray> changedDirs_;
+};
+
+}
+
+#endif // FM_FILEINDEX_H
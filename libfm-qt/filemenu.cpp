@@ -30,10 +30,24 @@
 #endif
 #include <QMessageBox>
 #include <QDebug>
+#include <string.h>
 #include "filemenu_p.h"
+#include "appinfocache_p.h"
 
 namespace Fm {
 
+// the same test as fm_file_info_list_is_same_fs(), for two files
+static bool isSameFs(FmFileInfo* fi1, FmFileInfo* fi2) {
+  bool native = fm_path_is_native(fm_file_info_get_path(fi1));
+  if(native != fm_path_is_native(fm_file_info_get_path(fi2)))
+    return false;
+  if(native)
+    return fm_file_info_get_dev(fi1) == fm_file_info_get_dev(fi2);
+  const char* fsId1 = fm_file_info_get_fs_id(fi1);
+  const char* fsId2 = fm_file_info_get_fs_id(fi2);
+  return fsId1 == fsId2 || (fsId1 && fsId2 && strcmp(fsId1, fsId2) == 0);
+}
+
 FileMenu::FileMenu(FmFileInfoList* files, FmFileInfo* info, FmPath* cwd, QWidget* parent):
   QMenu(parent),
   fileLauncher_(NULL) {
@@ -65,10 +79,18 @@ void FileMenu::createMenu(FmFileInfoList* files, FmFileInfo* info, FmPath* cwd)
   FmFileInfo* first = fm_file_info_list_peek_head(files);
   FmMimeType* mime_type = fm_file_info_get_mime_type(first);
   FmPath* path = fm_file_info_get_path(first);
-  // check if the files are of the same type
-  sameType_ = fm_file_info_list_is_same_type(files);
-  // check if the files are on the same filesystem
-  sameFilesystem_ = fm_file_info_list_is_same_fs(files);
+  // check the files in one pass:
+  // if they are of the same type and if they are on the same filesystem
+  sameType_ = true;
+  sameFilesystem_ = true;
+  GList* l = fm_file_info_list_peek_head_link(files);
+  for(l = l ? l->next : NULL; l && (sameType_ || sameFilesystem_); l = l->next) {
+    FmFileInfo* fi = FM_FILE_INFO(l->data);
+    if(sameType_ && fm_file_info_get_mime_type(fi) != mime_type)
+      sameType_ = false;
+    if(sameFilesystem_ && !isSameFs(first, fi))
+      sameFilesystem_ = false;
+  }
   // check if the files are all virtual
   allVirtual_ = sameFilesystem_ && fm_path_is_virtual(path);
   // check if the files are all in the trash can
@@ -81,30 +103,11 @@ void FileMenu::createMenu(FmFileInfoList* files, FmFileInfo* info, FmPath* cwd)
   openWithMenuAction_ = new QAction(tr("Open With..."), this);
   addAction(openWithMenuAction_);
   // create the "Open with..." sub menu
-  QMenu* menu = new QMenu();
+  // the applications are added when it's shown for the first time
+  openWithMenuLoaded_ = false;
+  QMenu* menu = new QMenu(this);
   openWithMenuAction_->setMenu(menu);
-
-  if(sameType_) { /* add specific menu items for this mime type */
-    if(mime_type && !allVirtual_) { /* the file has a valid mime-type and its not virtual */
-      GList* apps = g_app_info_get_all_for_type(fm_mime_type_get_type(mime_type));
-      GList* l;
-      for(l=apps;l;l=l->next) {
-        GAppInfo* app = G_APP_INFO(l->data);
-      
-        // check if the command really exists
-        gchar * program_path = g_find_program_in_path(g_app_info_get_executable(app));
-        if (!program_path)
-          continue;
-        g_free(program_path);
-
-        // create a QAction for the application.
-        AppInfoAction* action = new AppInfoAction(app);
-        connect(action, SIGNAL(triggered(bool)), SLOT(onApplicationTriggered()));
-        menu->addAction(action);
-      }
-      g_list_free(apps); /* don't unref GAppInfos now */
-    }
-  }
+  connect(menu, SIGNAL(aboutToShow()), SLOT(onOpenWithMenuAboutToShow()));
   menu->addSeparator();
   openWithAction_ = new QAction(tr("Other Applications"), this);
   connect(openWithAction_ , SIGNAL(triggered(bool)), SLOT(onOpenWithTriggered()));
@@ -208,6 +211,27 @@ void FileMenu::addCustomActionItem(QMenu* menu, FmFileActionItem* item) {
 }
 #endif
 
+void FileMenu::onOpenWithMenuAboutToShow() {
+  if(openWithMenuLoaded_)
+    return;
+  openWithMenuLoaded_ = true;
+  if(sameType_ && !allVirtual_) { /* add specific menu items for this mime type */
+    FmMimeType* mime_type = fm_file_info_get_mime_type(fm_file_info_list_peek_head(files_));
+    if(mime_type) { /* the file has a valid mime-type */
+      QMenu* menu = openWithMenuAction_->menu();
+      QAction* separator = menu->actions().first();
+      // the apps are looked up only once per mime type and cached
+      const QList<GAppInfo*>& apps = AppInfoCache::sharedCache()->appsForType(fm_mime_type_get_type(mime_type));
+      Q_FOREACH(GAppInfo* app, apps) {
+        // create a QAction for the application.
+        AppInfoAction* action = new AppInfoAction(app, menu);
+        connect(action, SIGNAL(triggered(bool)), SLOT(onApplicationTriggered()));
+        menu->insertAction(separator, action);
+      }
+    }
+  }
+}
+
 void FileMenu::onOpenTriggered() {
   if(fileLauncher_) {
     fileLauncher_->launchFiles(NULL, files_);
@@ -146,6 +146,7 @@ protected:
 protected Q_SLOTS:
   void onOpenTriggered();
   void onOpenWithTriggered();
+  void onOpenWithMenuAboutToShow();
   void onFilePropertiesTriggered();
   void onApplicationTriggered();
 #ifdef CUSTOM_ACTIONS
@@ -171,6 +172,7 @@ private:
   bool sameFilesystem_;
   bool allVirtual_;
   bool allTrash_;
+  bool openWithMenuLoaded_;
 
   QAction* openAction_;
   QAction* openWithMenuAction_;
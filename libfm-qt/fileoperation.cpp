@@ -20,20 +20,38 @@
 
 #include "fileoperation.h"
 #include "fileoperationdialog.h"
+#include "fileoperationqueue.h"
+#include "nativefileopsjob_p.h"
+#include "conflictdialog_p.h"
+#include "fileoperationjournal.h"
 #include <QTimer>
 #include <QMessageBox>
 
 using namespace Fm;
 
 #define SHOW_DLG_DELAY  1000
+// weight of the latest sample in the smoothed transfer rate
+#define RATE_SMOOTHING  0.3
 
 FileOperation::FileOperation(Type type, FmPathList* srcFiles, QObject* parent):
   QObject(parent),
   dlg(NULL),
   destPath(NULL),
   srcPaths(fm_path_list_ref(srcFiles)),
+  uiTimer(NULL),
   autoDestroy_(true),
-  job_(fm_file_ops_job_new((FmFileOpType)type, srcFiles)) {
+  queued_(false),
+  lastSampleTime_(0),
+  lastFinishedBytes_(0),
+  journal_(NULL),
+  // local copy and move are handled natively, others fall back to FmFileOpsJob.
+  job_(fm_native_file_ops_job_new((FmFileOpType)type, srcFiles)) {
+
+  stats_.totalBytes = 0;
+  stats_.finishedBytes = 0;
+  stats_.bytesPerSecond = 0;
+  stats_.remainingSeconds = -1;
+  stats_.elapsedSeconds = 0;
 
   g_signal_connect(job_, "ask", G_CALLBACK(onFileOpsJobAsk), this);
   g_signal_connect(job_, "ask-rename", G_CALLBACK(onFileOpsJobAskRename), this);
@@ -43,6 +61,7 @@ FileOperation::FileOperation(Type type, FmPathList* srcFiles, QObject* parent):
   g_signal_connect(job_, "percent", G_CALLBACK(onFileOpsJobPercent), this);
   g_signal_connect(job_, "finished", G_CALLBACK(onFileOpsJobFinished), this);
   g_signal_connect(job_, "cancelled", G_CALLBACK(onFileOpsJobCancelled), this);
+  g_signal_connect(job_, "resolve-conflicts", G_CALLBACK(onFileOpsJobResolveConflicts), this);
 }
 
 void FileOperation::disconnectJob() {
@@ -54,6 +73,7 @@ void FileOperation::disconnectJob() {
   g_signal_handlers_disconnect_by_func(job_, (gpointer)G_CALLBACK(onFileOpsJobPercent), this);
   g_signal_handlers_disconnect_by_func(job_, (gpointer)G_CALLBACK(onFileOpsJobFinished), this);
   g_signal_handlers_disconnect_by_func(job_, (gpointer)G_CALLBACK(onFileOpsJobCancelled), this);
+  g_signal_handlers_disconnect_by_func(job_, (gpointer)G_CALLBACK(onFileOpsJobResolveConflicts), this);
 }
 
 FileOperation::~FileOperation() {
@@ -63,6 +83,11 @@ FileOperation::~FileOperation() {
     uiTimer = NULL;
   }
 
+  // the job may still be writing the journal in its thread. the file is
+  // kept anyway, so the operation can be resumed next time.
+  if(journal_ && !isRunning())
+    delete journal_;
+
   if(job_) {
     disconnectJob();
     g_object_unref(job_);
@@ -76,23 +101,104 @@ FileOperation::~FileOperation() {
 }
 
 bool FileOperation::run() {
-  // run the job
-  uiTimer = new QTimer();
-  uiTimer->start(SHOW_DLG_DELAY);
-  connect(uiTimer, SIGNAL(timeout()), SLOT(onUiTimeout()));
+  // run the job. the timer is already running if the operation was queued.
+  if(!uiTimer) {
+    uiTimer = new QTimer();
+    uiTimer->start(SHOW_DLG_DELAY);
+    connect(uiTimer, SIGNAL(timeout()), SLOT(onUiTimeout()));
+  }
+  queued_ = false;
+  elapsedTimer_.start();
+
+  // keep a journal so the operation can be resumed if it's interrupted
+  if(!journal_)
+    journal_ = FileOperationJournal::create((FmFileOpType)job_->type, srcPaths, destPath);
+  FM_NATIVE_FILE_OPS_JOB(job_)->journal = journal_;
 
   return fm_job_run_async(FM_JOB(job_));
 }
 
+// show the dialog if the operation waits in the queue for long,
+// so the user knows it's there and can cancel it.
+void FileOperation::setQueued() {
+  queued_ = true;
+  if(!uiTimer) {
+    uiTimer = new QTimer();
+    uiTimer->start(SHOW_DLG_DELAY);
+    connect(uiTimer, SIGNAL(timeout()), SLOT(onUiTimeout()));
+  }
+}
+
+void FileOperation::cancel() {
+  if(queued_) {
+    // the job is not started yet, so the queue finishes the operation.
+    // this may be called by the dialog, which is deleted then, so do it later.
+    QMetaObject::invokeMethod(this, "onCancelQueued", Qt::QueuedConnection);
+    return;
+  }
+  if(job_)
+    fm_job_cancel(FM_JOB(job_));
+}
+
+void FileOperation::onCancelQueued() {
+  if(queued_) {
+    queued_ = false;
+    FileOperationQueue::instance()->cancel(this);
+  }
+  else // started in the mean time
+    cancel();
+}
+
 void FileOperation::onUiTimeout() {
+  if(queued_) {
+    showDialog();
+    dlg->setCurFile(tr("Waiting for the device..."));
+    return;
+  }
+  updateStats();
   if(dlg) {
     dlg->setCurFile(curFile);
+    dlg->setStats(stats_);
   }
   else{
     showDialog();
   }
 }
 
+// sample the byte counters of the job and compute the transfer rate and ETA.
+// the counters are updated by the job thread, but reading a slightly
+// outdated value here is harmless.
+void FileOperation::updateStats() {
+  if(!job_)
+    return;
+  qint64 now = elapsedTimer_.elapsed();
+  qint64 finishedBytes = job_->finished + job_->current_file_finished;
+  stats_.totalBytes = job_->total;
+  stats_.finishedBytes = finishedBytes;
+  stats_.elapsedSeconds = int(now / 1000);
+
+  qint64 interval = now - lastSampleTime_;
+  if(interval > 0) {
+    // progress can go back a little if copying a file fails
+    double rate = qMax(0.0, double(finishedBytes - lastFinishedBytes_) * 1000 / interval);
+    // exponential moving average. one fast or slow sample does not make the ETA jump.
+    if(lastSampleTime_ == 0)
+      stats_.bytesPerSecond = rate;
+    else
+      stats_.bytesPerSecond = RATE_SMOOTHING * rate + (1 - RATE_SMOOTHING) * stats_.bytesPerSecond;
+    lastSampleTime_ = now;
+    lastFinishedBytes_ = finishedBytes;
+  }
+
+  if(stats_.totalBytes > 0 && finishedBytes >= stats_.totalBytes)
+    stats_.remainingSeconds = 0;
+  else if(stats_.bytesPerSecond >= 1 && stats_.totalBytes > 0)
+    stats_.remainingSeconds = int((stats_.totalBytes - finishedBytes) / stats_.bytesPerSecond);
+  else // not prepared yet, or stalled
+    stats_.remainingSeconds = -1;
+  Q_EMIT statsChanged();
+}
+
 void FileOperation::showDialog() {
   if(!dlg) {
     dlg = new FileOperationDialog(this);
@@ -126,6 +232,14 @@ gint FileOperation::onFileOpsJobAskRename(FmFileOpsJob* job, FmFileInfo* src, Fm
   return ret;
 }
 
+// the job is done with everything else, and holds the files which exist in the destination
+void FileOperation::onFileOpsJobResolveConflicts(FmFileOpsJob* job, QList<FileConflict>* conflicts, FileOperation* pThis) {
+  pThis->showDialog();
+  ConflictDialog dlg(*conflicts, pThis->dlg);
+  if(dlg.exec() != QDialog::Accepted)
+    pThis->cancel();
+}
+
 void FileOperation::onFileOpsJobCancelled(FmFileOpsJob* job, FileOperation* pThis) {
   qDebug("file operation is cancelled!");
 }
@@ -162,10 +276,18 @@ void FileOperation::onFileOpsJobPrepared(FmFileOpsJob* job, FileOperation* pThis
 }
 
 void FileOperation::handleFinish() {
+  queued_ = false;
   disconnectJob();
   g_object_unref(job_);
   job_ = NULL;
 
+  // finished or cancelled by the user. nothing to resume.
+  if(journal_) {
+    journal_->remove();
+    delete journal_;
+    journal_ = NULL;
+  }
+
   if(uiTimer) {
     uiTimer->stop();
     delete uiTimer;
@@ -187,7 +309,7 @@ void FileOperation::handleFinish() {
 FileOperation* FileOperation::copyFiles(FmPathList* srcFiles, FmPath* dest, QWidget* parent) {
   FileOperation* op = new FileOperation(FileOperation::Copy, srcFiles);
   op->setDestination(dest);
-  op->run();
+  FileOperationQueue::instance()->enqueue(op);
   return op;
 }
 
@@ -195,7 +317,7 @@ FileOperation* FileOperation::copyFiles(FmPathList* srcFiles, FmPath* dest, QWid
 FileOperation* FileOperation::moveFiles(FmPathList* srcFiles, FmPath* dest, QWidget* parent) {
   FileOperation* op = new FileOperation(FileOperation::Move, srcFiles);
   op->setDestination(dest);
-  op->run();
+  FileOperationQueue::instance()->enqueue(op);
   return op;
 }
 
@@ -219,7 +341,7 @@ FileOperation* FileOperation::deleteFiles(FmPathList* srcFiles, bool prompt, QWi
   }
 
   FileOperation* op = new FileOperation(FileOperation::Delete, srcFiles);
-  op->run();
+  FileOperationQueue::instance()->enqueue(op);
   return op;
 }
 
@@ -235,7 +357,7 @@ FileOperation* FileOperation::trashFiles(FmPathList* srcFiles, bool prompt, QWid
   }
 
   FileOperation* op = new FileOperation(FileOperation::Trash, srcFiles);
-  op->run();
+  FileOperationQueue::instance()->enqueue(op);
   return op;
 }
 
@@ -246,3 +368,32 @@ FileOperation* FileOperation::changeAttrFiles(FmPathList* srcFiles, QWidget* par
   op->run();
   return op;
 }
+
+// static
+FileOperation* FileOperation::resume(FileOperationJournal* journal) {
+  // sources moved completely before the interruption are gone
+  FmPathList* srcFiles = fm_path_list_new();
+  Q_FOREACH(const QByteArray& srcPath, journal->srcPaths()) {
+    if(g_file_test(srcPath.constData(), G_FILE_TEST_EXISTS)
+       || g_file_test(srcPath.constData(), G_FILE_TEST_IS_SYMLINK)) {
+      FmPath* path = fm_path_new_for_str(srcPath.constData());
+      fm_path_list_push_tail(srcFiles, path);
+      fm_path_unref(path);
+    }
+  }
+  if(fm_path_list_is_empty(srcFiles)) {
+    fm_path_list_unref(srcFiles);
+    journal->remove();
+    delete journal;
+    return NULL;
+  }
+
+  FileOperation* op = new FileOperation((Type)journal->type(), srcFiles);
+  fm_path_list_unref(srcFiles);
+  FmPath* dest = fm_path_new_for_str(journal->destPath().constData());
+  op->setDestination(dest);
+  fm_path_unref(dest);
+  op->journal_ = journal;
+  FileOperationQueue::instance()->enqueue(op);
+  return op;
+}
@@ -23,6 +23,8 @@
 
 #include "libfmqtglobals.h"
 #include <QObject>
+#include <QElapsedTimer>
+#include <QList>
 #include <libfm/fm.h>
 
 class QTimer;
@@ -30,9 +32,13 @@ class QTimer;
 namespace Fm {
 
 class FileOperationDialog;
+class FileOperationQueue;
+struct FileConflict;
+class FileOperationJournal;
 
 class LIBFM_QT_API FileOperation : public QObject {
 Q_OBJECT
+friend class FileOperationQueue;
 public:
   enum Type {
     Copy = FM_FILE_OP_COPY,
@@ -44,6 +50,16 @@ public:
     ChangeAttr = FM_FILE_OP_CHANGE_ATTR
   };
 
+  // progress of the operation, sampled from the job periodically.
+  // Delete, Trash, Untrash and ChangeAttr count files instead of bytes.
+  struct Stats {
+    qint64 totalBytes;
+    qint64 finishedBytes;
+    double bytesPerSecond; // smoothed transfer rate
+    int remainingSeconds; // -1 if unknown
+    int elapsedSeconds;
+  };
+
 public:
   explicit FileOperation(Type type, FmPathList* srcFiles, QObject* parent = 0);
   virtual ~FileOperation();
@@ -53,6 +69,14 @@ public:
     fm_file_ops_job_set_dest(job_, dest);
   }
 
+  FmPath* destination() {
+    return destPath;
+  }
+
+  FmPathList* srcFiles() {
+    return srcPaths;
+  }
+
   void setChmod(mode_t newMode, mode_t newModeMask) {
     fm_file_ops_job_set_chmod(job_, newMode, newModeMask);
   }
@@ -68,10 +92,7 @@ public:
 
   bool run();
 
-  void cancel() {
-    if(job_)
-      fm_job_cancel(FM_JOB(job_));
-  }
+  void cancel();
 
   bool isRunning() const {
     return job_ ? fm_job_is_running(FM_JOB(job_)) : false;
@@ -95,17 +116,27 @@ public:
   Type type() {
     return (Type)job_->type;
   }
+
+  const Stats& stats() const {
+    return stats_;
+  }
   
   // convinient static functions
+  // copy, move, delete, and trash operations are scheduled by FileOperationQueue
   static FileOperation* copyFiles(FmPathList* srcFiles, FmPath* dest, QWidget* parent = 0);
   static FileOperation* moveFiles(FmPathList* srcFiles, FmPath* dest, QWidget* parent = 0);
   static FileOperation* symlinkFiles(FmPathList* srcFiles, FmPath* dest, QWidget* parent = 0);
   static FileOperation* deleteFiles(FmPathList* srcFiles, bool promp = true, QWidget* parent = 0);
   static FileOperation* trashFiles(FmPathList* srcFiles, bool promp = true, QWidget* parent = 0);
   static FileOperation* changeAttrFiles(FmPathList* srcFiles, QWidget* parent = 0);
+  // resume an interrupted operation. the operation takes the ownership of the journal.
+  static FileOperation* resume(FileOperationJournal* journal);
 
 Q_SIGNALS:
   void finished();
+  // emitted each time stats() is updated. that's once a second while running,
+  // and twice a second once the progress dialog is shown.
+  void statsChanged();
   
 private:
   static gint onFileOpsJobAsk(FmFileOpsJob* job, const char* question, char* const* options, FileOperation* pThis);
@@ -116,13 +147,18 @@ private:
   static void onFileOpsJobPercent(FmFileOpsJob* job, guint percent, FileOperation* pThis);
   static void onFileOpsJobFinished(FmFileOpsJob* job, FileOperation* pThis);
   static void onFileOpsJobCancelled(FmFileOpsJob* job, FileOperation* pThis);
+  static void onFileOpsJobResolveConflicts(FmFileOpsJob* job, QList<FileConflict>* conflicts, FileOperation* pThis);
 
   void handleFinish();
   void disconnectJob();
   void showDialog();
+  void updateStats();
+  // called by FileOperationQueue while the operation waits for its devices
+  void setQueued();
 
 private Q_SLOTS:
   void onUiTimeout();
+  void onCancelQueued();
   
 private:
   FmFileOpsJob* job_;
@@ -132,6 +168,12 @@ private:
   QTimer* uiTimer;
   QString curFile;
   bool autoDestroy_;
+  bool queued_; // waiting in FileOperationQueue
+  Stats stats_;
+  QElapsedTimer elapsedTimer_;
+  qint64 lastSampleTime_;
+  qint64 lastFinishedBytes_;
+  FileOperationJournal* journal_;
 
 };
 
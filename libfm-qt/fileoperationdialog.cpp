@@ -149,6 +149,46 @@ void FileOperationDialog::setPercent(unsigned int percent) {
   ui->progressBar->setValue(percent);
 }
 
+void FileOperationDialog::setStats(const FileOperation::Stats& stats) {
+  switch(operation->type()) {
+  case FM_FILE_OP_DELETE:
+  case FM_FILE_OP_TRASH:
+  case FM_FILE_OP_UNTRASH:
+  case FM_FILE_OP_CHANGE_ATTR:
+    // these jobs count files instead of bytes
+    ui->transferred->setText(tr("%1 of %2 files")
+                             .arg(stats.finishedBytes)
+                             .arg(stats.totalBytes));
+    break;
+  default:
+    setTransferredBytes(stats);
+    break;
+  }
+
+  if(stats.remainingSeconds >= 0) {
+    int secs = stats.remainingSeconds;
+    ui->timeRemaining->setText(QString("%1:%2:%3")
+                               .arg(secs / 3600, 2, 10, QChar('0'))
+                               .arg((secs / 60) % 60, 2, 10, QChar('0'))
+                               .arg(secs % 60, 2, 10, QChar('0')));
+  }
+  else
+    ui->timeRemaining->setText(tr("Unknown"));
+}
+
+void FileOperationDialog::setTransferredBytes(const FileOperation::Stats& stats) {
+  char finished[64];
+  char total[64];
+  char rate[64];
+  fm_file_size_to_str(finished, sizeof(finished), stats.finishedBytes, fm_config->si_unit);
+  fm_file_size_to_str(total, sizeof(total), stats.totalBytes, fm_config->si_unit);
+  fm_file_size_to_str(rate, sizeof(rate), (goffset)stats.bytesPerSecond, fm_config->si_unit);
+  ui->transferred->setText(tr("%1 of %2 (%3/s)")
+                           .arg(QString::fromUtf8(finished))
+                           .arg(QString::fromUtf8(total))
+                           .arg(QString::fromUtf8(rate)));
+}
+
 void FileOperationDialog::setPrepared() {
 }
 
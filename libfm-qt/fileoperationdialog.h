@@ -24,6 +24,7 @@
 #include "libfmqtglobals.h"
 #include <QDialog>
 #include <libfm/fm.h>
+#include "fileoperation.h"
 
 namespace Ui {
   class FileOperationDialog;
@@ -31,8 +32,6 @@ namespace Ui {
 
 namespace Fm {
 
-class FileOperation;
-
 class LIBFM_QT_API FileOperationDialog : public QDialog {
 Q_OBJECT
 public:
@@ -48,9 +47,13 @@ public:
   void setPrepared();
   void setCurFile(QString cur_file);
   void setPercent(unsigned int percent);
+  void setStats(const FileOperation::Stats& stats);
 
   virtual void reject();
   
+private:
+  void setTransferredBytes(const FileOperation::Stats& stats);
+
 private:
   Ui::FileOperationDialog* ui;
   FileOperation* operation;
@@ -0,0 +1,252 @@
+/*
+
+    Copyright (C) 2013  Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#include "fileoperationjournal.h"
+#include <QDir>
+#include <QFile>
+#include <QDateTime>
+#include <QMutexLocker>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+// the journal is a text file. after the magic line, each line is a record:
+// "T <type>", "C <start time>", "D <dest>", "S <source>" for each source,
+// "B" after the last source, "P <dest file>" for each file created in the
+// destination, and "F <size> <mtime> <source file>" for each finished file.
+// paths are percent-encoded.
+#define JOURNAL_MAGIC       "pcmanfm-qt-journal 1\n"
+#define JOURNAL_SUFFIX      ".journal"
+// min interval of syncing the journal to the disk in microseconds
+#define SYNC_INTERVAL       (1000 * 1000)
+
+using namespace Fm;
+
+QString FileOperationJournal::journalDir_;
+
+static QByteArray encodePath(const char* path) {
+  return QByteArray(path).toPercentEncoding("/");
+}
+
+FileOperationJournal::FileOperationJournal(const QString& fileName, int fd):
+  fileName_(fileName),
+  fd_(fd),
+  type_(FM_FILE_OP_NONE),
+  startTime_(0),
+  resumed_(false),
+  lastSyncTime_(0) {
+}
+
+FileOperationJournal::~FileOperationJournal() {
+  if(fd_ >= 0)
+    close(fd_);
+}
+
+// static
+FileOperationJournal* FileOperationJournal::create(FmFileOpType type, FmPathList* srcs, FmPath* dest) {
+  if(journalDir_.isEmpty() || (type != FM_FILE_OP_COPY && type != FM_FILE_OP_MOVE))
+    return NULL;
+  // only local files are journaled since they're verified with stat()
+  if(!dest || !fm_path_is_native(dest))
+    return NULL;
+
+  QByteArray data = JOURNAL_MAGIC;
+  data += "T " + QByteArray::number(int(type)) + '\n';
+  data += "C " + QByteArray::number(qint64(time(NULL))) + '\n';
+  char* str = fm_path_to_str(dest);
+  data += "D " + encodePath(str) + '\n';
+  g_free(str);
+  for(GList* l = fm_path_list_peek_head_link(srcs); l; l = l->next) {
+    FmPath* path = FM_PATH(l->data);
+    if(!fm_path_is_native(path))
+      return NULL;
+    str = fm_path_to_str(path);
+    data += "S " + encodePath(str) + '\n';
+    g_free(str);
+  }
+  data += "B\n";
+
+  if(!QDir().mkpath(journalDir_))
+    return NULL;
+  static int serial = 0;
+  QString fileName = QString("%1/%2-%3" JOURNAL_SUFFIX)
+                     .arg(journalDir_)
+                     .arg(QDateTime::currentMSecsSinceEpoch())
+                     .arg(serial++);
+  int fd = open(QFile::encodeName(fileName).constData(), O_WRONLY|O_CREAT|O_EXCL|O_APPEND, 0600);
+  if(fd < 0)
+    return NULL;
+  FileOperationJournal* journal = new FileOperationJournal(fileName, fd);
+  if(!journal->parse(data) || !journal->append(data)) {
+    journal->remove();
+    delete journal;
+    return NULL;
+  }
+  fdatasync(fd); // the header must survive a crash
+  return journal;
+}
+
+// static
+QStringList FileOperationJournal::interruptedJournals() {
+  QStringList fileNames;
+  if(journalDir_.isEmpty())
+    return fileNames;
+  QDir dir(journalDir_);
+  Q_FOREACH(const QString& name, dir.entryList(QStringList("*" JOURNAL_SUFFIX), QDir::Files, QDir::Name))
+    fileNames.append(dir.filePath(name));
+  return fileNames;
+}
+
+// static
+FileOperationJournal* FileOperationJournal::load(const QString& fileName) {
+  QFile file(fileName);
+  if(!file.open(QIODevice::ReadOnly))
+    return NULL;
+  QByteArray data = file.readAll();
+  file.close();
+
+  int fd = open(QFile::encodeName(fileName).constData(), O_WRONLY|O_APPEND);
+  if(fd < 0)
+    return NULL;
+  FileOperationJournal* journal = new FileOperationJournal(fileName, fd);
+  if(!journal->parse(data)) {
+    journal->remove();
+    delete journal;
+    return NULL;
+  }
+  // cut off the incomplete last record ignored by parse(). otherwise the
+  // first record appended after resuming is glued to it and lost.
+  int end = data.lastIndexOf('\n') + 1;
+  if(end < data.size() && ftruncate(fd, end) != 0) {
+    delete journal; // keep the file. it may be resumed next time.
+    return NULL;
+  }
+  journal->resumed_ = true;
+  return journal;
+}
+
+bool FileOperationJournal::parse(const QByteArray& data) {
+  if(!data.startsWith(JOURNAL_MAGIC))
+    return false;
+  bool hasSources = false;
+  int pos = sizeof(JOURNAL_MAGIC) - 1;
+  for(;;) {
+    int end = data.indexOf('\n', pos);
+    if(end < 0) // nothing left, or the last record is incomplete because of a crash
+      break;
+    QByteArray line = data.mid(pos, end - pos);
+    pos = end + 1;
+    if(line.isEmpty())
+      continue;
+    QByteArray value = line.mid(2);
+    switch(line[0]) {
+    case 'T':
+      type_ = FmFileOpType(value.toInt());
+      break;
+    case 'C':
+      startTime_ = time_t(value.toLongLong());
+      break;
+    case 'D':
+      destPath_ = QByteArray::fromPercentEncoding(value);
+      break;
+    case 'S':
+      srcPaths_.append(QByteArray::fromPercentEncoding(value));
+      break;
+    case 'B':
+      hasSources = true;
+      break;
+    case 'P':
+      createdFiles_.insert(QByteArray::fromPercentEncoding(value));
+      break;
+    case 'F': {
+      QList<QByteArray> fields = value.split(' ');
+      if(fields.size() == 3) {
+        FinishedFile file;
+        file.size = fields[0].toLongLong();
+        file.mtime = fields[1].toLongLong();
+        finishedFiles_.insert(QByteArray::fromPercentEncoding(fields[2]), file);
+      }
+      break;
+    }
+    }
+  }
+  return hasSources && !destPath_.isEmpty() && (type_ == FM_FILE_OP_COPY || type_ == FM_FILE_OP_MOVE);
+}
+
+bool FileOperationJournal::append(const QByteArray& data) {
+  const char* p = data.constData();
+  qint64 left = data.size();
+  while(left > 0) {
+    ssize_t n = ::write(fd_, p, left);
+    if(n < 0) {
+      if(errno == EINTR)
+        continue;
+      return false;
+    }
+    p += n;
+    left -= n;
+  }
+  return true;
+}
+
+void FileOperationJournal::addFinishedFile(const QByteArray& src, const struct stat& st) {
+  addRecord("F " + QByteArray::number(qint64(st.st_size)) + ' '
+            + QByteArray::number(qint64(st.st_mtime)) + ' '
+            + encodePath(src.constData()) + '\n');
+}
+
+void FileOperationJournal::addCreatedFile(const QByteArray& dest) {
+  addRecord("P " + encodePath(dest.constData()) + '\n');
+}
+
+void FileOperationJournal::addRecord(const QByteArray& line) {
+  QMutexLocker locker(&lock_);
+  if(fd_ < 0)
+    return;
+  // each record is written with one call, so it's in the file even if we
+  // crash right after. syncing it to the disk is only done once in a while.
+  append(line);
+  gint64 now = g_get_monotonic_time();
+  if(now - lastSyncTime_ >= SYNC_INTERVAL) {
+    lastSyncTime_ = now;
+    fdatasync(fd_);
+  }
+}
+
+bool FileOperationJournal::isFinished(const QByteArray& src, const struct stat& st) const {
+  // finishedFiles_ is not changed after loading, so no locking is needed.
+  QHash<QByteArray, FinishedFile>::const_iterator it = finishedFiles_.constFind(src);
+  return it != finishedFiles_.constEnd() && it->size == st.st_size && it->mtime == st.st_mtime;
+}
+
+bool FileOperationJournal::isCreated(const QByteArray& dest) const {
+  // createdFiles_ is not changed after loading, so no locking is needed.
+  return createdFiles_.contains(dest);
+}
+
+void FileOperationJournal::remove() {
+  QMutexLocker locker(&lock_);
+  if(fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+  QFile::remove(fileName_);
+}
@@ -0,0 +1,138 @@
+/*
+
+    Copyright (C) 2013  Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+
+#ifndef FM_FILEOPERATIONJOURNAL_H
+#define FM_FILEOPERATIONJOURNAL_H
+
+#include "libfmqtglobals.h"
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <libfm/fm.h>
+
+namespace Fm {
+
+// An append-only record of a copy or move operation, kept in the journal
+// dir while the operation is running. It lists the source files, the
+// destination, and every file finished so far. If the program crashes or
+// the session ends, the journal is left behind, and the operation can be
+// resumed from it later. Files already finished are verified by their
+// size and mtime and skipped.
+class LIBFM_QT_API FileOperationJournal {
+public:
+  ~FileOperationJournal();
+
+  // operations are only journaled if the dir is set
+  static void setJournalDir(const QString& dir) {
+    journalDir_ = dir;
+  }
+
+  static QString journalDir() {
+    return journalDir_;
+  }
+
+  // start a journal for a new operation. returns NULL if the operation is
+  // not journaled, or the file cannot be created.
+  static FileOperationJournal* create(FmFileOpType type, FmPathList* srcs, FmPath* dest);
+
+  // journals left behind by interrupted operations
+  static QStringList interruptedJournals();
+
+  // open an existing journal to resume the operation.
+  // returns NULL if it's broken, and the broken journal is removed.
+  static FileOperationJournal* load(const QString& fileName);
+
+  FmFileOpType type() const {
+    return type_;
+  }
+
+  // local paths of the sources and the destination dir
+  const QList<QByteArray>& srcPaths() const {
+    return srcPaths_;
+  }
+
+  const QByteArray& destPath() const {
+    return destPath_;
+  }
+
+  // time the operation was first started
+  time_t startTime() const {
+    return startTime_;
+  }
+
+  // the journal is loaded from an interrupted operation
+  bool isResumed() const {
+    return resumed_;
+  }
+
+  // record that the source file is done. it's called from different threads.
+  void addFinishedFile(const QByteArray& src, const struct stat& st);
+
+  // check if the source file was finished before the operation is interrupted,
+  // and the file is not changed since then.
+  bool isFinished(const QByteArray& src, const struct stat& st) const;
+
+  // record that the destination file is created by this operation.
+  // it's called from different threads.
+  void addCreatedFile(const QByteArray& dest);
+
+  // check if the destination file was created by the interrupted operation,
+  // so an incomplete copy left there can be replaced without asking.
+  bool isCreated(const QByteArray& dest) const;
+
+  // remove the journal file once the operation is done or cancelled
+  void remove();
+
+private:
+  FileOperationJournal(const QString& fileName, int fd);
+  bool append(const QByteArray& data);
+  void addRecord(const QByteArray& line);
+  bool parse(const QByteArray& data);
+
+private:
+  struct FinishedFile {
+    qint64 size;
+    qint64 mtime;
+  };
+
+  QString fileName_;
+  int fd_;
+  FmFileOpType type_;
+  time_t startTime_;
+  QList<QByteArray> srcPaths_;
+  QByteArray destPath_;
+  QHash<QByteArray, FinishedFile> finishedFiles_; // loaded from an old journal
+  QSet<QByteArray> createdFiles_; // loaded from an old journal
+  bool resumed_;
+  gint64 lastSyncTime_;
+  QMutex lock_;
+
+  static QString journalDir_;
+};
+
+}
+
+#endif // FM_FILEOPERATIONJOURNAL_H
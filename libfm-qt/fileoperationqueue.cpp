@@ -0,0 +1,411 @@
+/*
+
+    Copyright (C) 2013  Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+
+#include "fileoperationqueue.h"
+#include "fileoperation.h"
+#include <QFile>
+#include <QByteArray>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QMutex>
+#include <QMutexLocker>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <sys/sysmacros.h>
+
+using namespace Fm;
+
+// max number of operations running on the same fast device at the same time
+#define MAX_JOBS_PER_FAST_DEVICE  4
+// max number of threads looking up the devices. a hung network mount
+// only blocks one of them.
+#define MAX_RESOLVE_THREADS       4
+
+FileOperationQueue* FileOperationQueue::theQueue = NULL;
+
+// network file systems are slow and should not be accessed concurrently
+static bool isNetworkFileSystem(unsigned long type) {
+  switch(type) {
+  case 0x6969: // NFS
+  case 0x517B: // SMB
+  case 0xFF534D42: // CIFS
+  case 0x65735546: // FUSE, sshfs for example
+    return true;
+  }
+  return false;
+}
+
+// read a flag in sysfs of the block device, or of the disk containing the partition
+static bool readBlockDeviceFlag(dev_t dev, const char* attr) {
+  QByteArray dir = "/sys/dev/block/" + QByteArray::number(major(dev)) + ':' + QByteArray::number(minor(dev));
+  QFile file(dir + '/' + attr);
+  if(!file.open(QIODevice::ReadOnly)) {
+    file.setFileName(dir + "/../" + attr);
+    if(!file.open(QIODevice::ReadOnly))
+      return false;
+  }
+  return file.readAll().trimmed() == "1";
+}
+
+// the results of ResolveTask. a task stuck on a hung mount may outlive the
+// queue, so this is freed by whoever releases the last reference.
+struct FileOperationQueue::ResolveResults {
+  QMutex lock;
+  QHash<int, QList<Device> > devices;
+  FileOperationQueue* queue; // NULL after the queue is destroyed
+  int refCount; // the queue and each task hold one. guarded by lock
+
+  // returns true if this was the last reference. must be called with lock held.
+  bool unref() {
+    return --refCount == 0;
+  }
+};
+
+// look up the devices of an operation in a worker thread
+class FileOperationQueue::ResolveTask : public QRunnable {
+public:
+  ResolveTask(ResolveResults* results, int serial, FmPathList* srcs, FmPath* dest):
+    results_(results),
+    serial_(serial),
+    srcs_(fm_path_list_ref(srcs)),
+    dest_(dest ? fm_path_ref(dest) : NULL) {
+    QMutexLocker locker(&results_->lock);
+    ++results_->refCount;
+  }
+
+  virtual ~ResolveTask() {
+    fm_path_list_unref(srcs_);
+    if(dest_)
+      fm_path_unref(dest_);
+  }
+
+  virtual void run() {
+    QList<Device> devices = devicesOf(srcs_, dest_);
+    bool last;
+    {
+      QMutexLocker locker(&results_->lock);
+      if(results_->queue) { // the results are dropped after the queue is gone
+        results_->devices.insert(serial_, devices);
+        QMetaObject::invokeMethod(results_->queue, "onDevicesResolved", Qt::QueuedConnection);
+      }
+      last = results_->unref();
+    }
+    if(last)
+      delete results_;
+  }
+
+private:
+  ResolveResults* results_;
+  int serial_;
+  FmPathList* srcs_;
+  FmPath* dest_;
+};
+
+FileOperationQueue::FileOperationQueue(QObject* parent):
+  QObject(parent),
+  pool_(new QThreadPool()),
+  results_(new ResolveResults()),
+  lastSerial_(0) {
+  pool_->setMaxThreadCount(MAX_RESOLVE_THREADS);
+  results_->queue = this;
+  results_->refCount = 1;
+}
+
+FileOperationQueue::~FileOperationQueue() {
+  bool last;
+  {
+    QMutexLocker locker(&results_->lock);
+    results_->queue = NULL;
+    last = results_->unref();
+  }
+  if(last)
+    delete results_;
+  // deleting the pool waits for its tasks. a task may be blocked on a hung
+  // network mount, so the pool is leaked rather than blocking the exit.
+  if(pool_->activeThreadCount() == 0)
+    delete pool_;
+  qDeleteAll(pending_);
+  qDeleteAll(running_);
+  if(theQueue == this)
+    theQueue = NULL;
+}
+
+// static
+FileOperationQueue* FileOperationQueue::instance() {
+  if(!theQueue)
+    theQueue = new FileOperationQueue();
+  return theQueue;
+}
+
+// static
+void FileOperationQueue::addDevice(QList<Device>& devices, FmPath* path) {
+  Device device;
+  if(fm_path_is_native(path)) {
+    // a path which doesn't exist yet, like a new destination dir,
+    // is on the device of its nearest existing parent.
+    struct stat st;
+    struct statfs fs;
+    bool ok = false;
+    for(FmPath* p = path; p && !ok; p = fm_path_get_parent(p)) {
+      char* filename = fm_path_to_str(p);
+      ok = (stat(filename, &st) == 0 && statfs(filename, &fs) == 0);
+      g_free(filename);
+    }
+    if(ok) {
+      device.id = QString("dev:%1:%2").arg(major(st.st_dev)).arg(minor(st.st_dev));
+      bool slow;
+      if(isNetworkFileSystem((unsigned long)fs.f_type))
+        slow = true;
+      else if(major(st.st_dev) == 0) // not a block device (tmpfs, btrfs...), we cannot tell.
+        slow = false;
+      else
+        slow = readBlockDeviceFlag(st.st_dev, "queue/rotational") || readBlockDeviceFlag(st.st_dev, "removable");
+      device.maxJobs = slow ? 1 : MAX_JOBS_PER_FAST_DEVICE;
+    }
+    else { // we cannot tell. don't let it run with others on an unknown device, either.
+      device.id = "dev:unknown";
+      device.maxJobs = 1;
+    }
+  }
+  else {
+    // remote or virtual files. use the root of the URI, such as sftp://host/, as the device.
+    FmPath* root = path;
+    while(fm_path_get_parent(root))
+      root = fm_path_get_parent(root);
+    char* uri = fm_path_to_uri(root);
+    device.id = QString::fromUtf8(uri);
+    g_free(uri);
+    device.maxJobs = 1;
+  }
+  Q_FOREACH(const Device& other, devices) {
+    if(other.id == device.id)
+      return;
+  }
+  devices.append(device);
+}
+
+// called in the worker threads
+// static
+QList<FileOperationQueue::Device> FileOperationQueue::devicesOf(FmPathList* srcs, FmPath* dest) {
+  QList<Device> devices;
+  FmPath* lastDir = NULL;
+  for(GList* l = fm_path_list_peek_head_link(srcs); l; l = l->next) {
+    FmPath* path = FM_PATH(l->data);
+    FmPath* dir = fm_path_get_parent(path);
+    if(!dir)
+      dir = path;
+    // selected files are mostly in the same dir. avoid checking it again.
+    if(dir == lastDir)
+      continue;
+    lastDir = dir;
+    addDevice(devices, dir);
+  }
+  if(dest)
+    addDevice(devices, dest);
+  return devices;
+}
+
+void FileOperationQueue::enqueue(FileOperation* op) {
+  Item* item = new Item();
+  item->op = op;
+  item->serial = ++lastSerial_;
+  item->resolved = false;
+  item->paused = false;
+  pending_.append(item);
+  // the operation is started after its devices are known
+  pool_->start(new ResolveTask(results_, item->serial, op->srcFiles(), op->destination()));
+  op->setQueued();
+  Q_EMIT changed();
+}
+
+void FileOperationQueue::onDevicesResolved() {
+  QHash<int, QList<Device> > results;
+  {
+    QMutexLocker locker(&results_->lock);
+    results = results_->devices;
+    results_->devices.clear();
+  }
+  // the results of the cancelled operations are dropped
+  Q_FOREACH(Item* item, pending_) {
+    QHash<int, QList<Device> >::const_iterator it = results.constFind(item->serial);
+    if(it != results.constEnd()) {
+      item->devices = it.value();
+      item->resolved = true;
+    }
+  }
+  schedule();
+}
+
+FileOperationQueue::Item* FileOperationQueue::findItem(const QList<Item*>& items, FileOperation* op) const {
+  Q_FOREACH(Item* item, items) {
+    if(item->op == op)
+      return item;
+  }
+  return NULL;
+}
+
+// start pending operations whose devices are available
+void FileOperationQueue::schedule() {
+  QList<Item*> startList;
+  QHash<QString, int> jobs = deviceJobs_;
+  QList<QString> reserved; // devices needed by earlier operations still waiting
+  for(int i = 0; i < pending_.size();) {
+    Item* item = pending_[i];
+    // the devices of an unresolved item are not known, so it cannot hold the later ones.
+    if(item->paused || !item->resolved) {
+      ++i;
+      continue;
+    }
+    bool canRun = true;
+    Q_FOREACH(const Device& device, item->devices) {
+      if(reserved.contains(device.id) || jobs.value(device.id, 0) >= device.maxJobs) {
+        canRun = false;
+        break;
+      }
+    }
+    if(canRun) {
+      Q_FOREACH(const Device& device, item->devices) {
+        ++jobs[device.id];
+      }
+      pending_.removeAt(i);
+      startList.append(item);
+    }
+    else {
+      // later operations should not overtake this one on the same devices
+      Q_FOREACH(const Device& device, item->devices) {
+        reserved.append(device.id);
+      }
+      ++i;
+    }
+  }
+  Q_FOREACH(Item* item, startList) {
+    start(item);
+  }
+}
+
+void FileOperationQueue::start(Item* item) {
+  running_.append(item);
+  Q_FOREACH(const Device& device, item->devices) {
+    ++deviceJobs_[device.id];
+  }
+  connect(item->op, SIGNAL(finished()), SLOT(onOperationFinished()));
+  if(!item->op->run())
+    finish(item);
+}
+
+void FileOperationQueue::finish(Item* item) {
+  running_.removeOne(item);
+  Q_FOREACH(const Device& device, item->devices) {
+    if(--deviceJobs_[device.id] <= 0)
+      deviceJobs_.remove(device.id);
+  }
+  disconnect(item->op, SIGNAL(finished()), this, SLOT(onOperationFinished()));
+  delete item;
+  schedule();
+  Q_EMIT changed();
+}
+
+void FileOperationQueue::onOperationFinished() {
+  // NOTE: the operation may delete itself after this signal, so don't keep it.
+  FileOperation* op = static_cast<FileOperation*>(sender());
+  Item* item = findItem(running_, op);
+  if(item)
+    finish(item);
+}
+
+QList<FileOperation*> FileOperationQueue::pendingOperations() const {
+  QList<FileOperation*> ops;
+  Q_FOREACH(Item* item, pending_) {
+    ops.append(item->op);
+  }
+  return ops;
+}
+
+QList<FileOperation*> FileOperationQueue::runningOperations() const {
+  QList<FileOperation*> ops;
+  Q_FOREACH(Item* item, running_) {
+    ops.append(item->op);
+  }
+  return ops;
+}
+
+bool FileOperationQueue::isPaused(FileOperation* op) const {
+  Item* item = findItem(pending_, op);
+  if(!item)
+    item = findItem(running_, op);
+  return item ? item->paused : false;
+}
+
+void FileOperationQueue::pause(FileOperation* op) {
+  Item* item = findItem(pending_, op);
+  if(item)
+    item->paused = true;
+  else if((item = findItem(running_, op)) && !item->paused) {
+    // the job keeps its devices while being suspended
+    item->paused = fm_job_pause(FM_JOB(op->job()));
+  }
+  else
+    return;
+  schedule(); // operations waiting for this one may run now
+  Q_EMIT changed();
+}
+
+void FileOperationQueue::resume(FileOperation* op) {
+  Item* item = findItem(pending_, op);
+  if(item)
+    item->paused = false;
+  else if((item = findItem(running_, op)) && item->paused) {
+    fm_job_resume(FM_JOB(op->job()));
+    item->paused = false;
+  }
+  else
+    return;
+  schedule();
+  Q_EMIT changed();
+}
+
+void FileOperationQueue::move(FileOperation* op, int pos) {
+  Item* item = findItem(pending_, op);
+  if(item) {
+    pending_.removeOne(item);
+    pending_.insert(qBound(0, pos, pending_.size()), item);
+    schedule();
+    Q_EMIT changed();
+  }
+}
+
+void FileOperationQueue::cancel(FileOperation* op) {
+  Item* item = findItem(pending_, op);
+  if(item) {
+    pending_.removeOne(item);
+    delete item;
+    Q_EMIT changed();
+    // the job is never started, so finish the operation here.
+    op->cancel();
+    op->handleFinish();
+  }
+  else if((item = findItem(running_, op))) {
+    if(item->paused) // the suspended job needs to run to see the cancellation
+      fm_job_resume(FM_JOB(op->job()));
+    op->cancel();
+  }
+}
@@ -0,0 +1,116 @@
+/*
+
+    Copyright (C) 2013  Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+
+#ifndef FM_FILEOPERATIONQUEUE_H
+#define FM_FILEOPERATIONQUEUE_H
+
+#include "libfmqtglobals.h"
+#include <QObject>
+#include <QList>
+#include <QHash>
+#include <QString>
+#include <libfm/fm.h>
+
+class QThreadPool;
+
+namespace Fm {
+
+class FileOperation;
+
+// Schedules file operations by the devices they read from and write to.
+// Operations on a slow device (rotational, removable, or remote) run one
+// at a time, while operations on independent devices run in parallel.
+// Operations waiting in the queue can be paused, resumed, and reordered.
+// The devices are looked up in worker threads, since stat() on a stale
+// network mount can block for a long time. The queue does not wait for
+// them when it's destroyed, and their results are dropped.
+class LIBFM_QT_API FileOperationQueue : public QObject {
+Q_OBJECT
+public:
+  explicit FileOperationQueue(QObject* parent = 0);
+  virtual ~FileOperationQueue();
+
+  static FileOperationQueue* instance();
+
+  // add the operation to the queue. it's started as soon as its devices are available.
+  void enqueue(FileOperation* op);
+
+  // operations waiting to be run, in the order they will be started
+  QList<FileOperation*> pendingOperations() const;
+  QList<FileOperation*> runningOperations() const;
+
+  bool isPaused(FileOperation* op) const;
+  // pending operations are held in the queue, running ones are suspended
+  void pause(FileOperation* op);
+  void resume(FileOperation* op);
+
+  // move a pending operation to the specified position in the queue
+  void move(FileOperation* op, int pos);
+
+  // cancel an operation, no matter it's running or pending
+  void cancel(FileOperation* op);
+
+Q_SIGNALS:
+  void changed();
+
+private Q_SLOTS:
+  void onOperationFinished();
+  void onDevicesResolved();
+
+private:
+  struct Device {
+    QString id;
+    int maxJobs; // max number of operations allowed to run on the device at the same time
+  };
+
+  struct Item {
+    FileOperation* op;
+    int serial; // identifies the item in the results of ResolveTask
+    QList<Device> devices;
+    bool resolved; // the devices are looked up
+    bool paused;
+  };
+
+  class ResolveTask;
+  friend class ResolveTask;
+  struct ResolveResults;
+
+  Item* findItem(const QList<Item*>& items, FileOperation* op) const;
+  void schedule();
+  void start(Item* item);
+  void finish(Item* item);
+
+  static QList<Device> devicesOf(FmPathList* srcs, FmPath* dest);
+  static void addDevice(QList<Device>& devices, FmPath* path);
+
+private:
+  QList<Item*> pending_;
+  QList<Item*> running_;
+  QHash<QString, int> deviceJobs_; // number of running operations per device
+  QThreadPool* pool_;
+  ResolveResults* results_; // shared with the running ResolveTasks
+  int lastSerial_;
+  static FileOperationQueue* theQueue;
+};
+
+}
+
+#endif // FM_FILEOPERATIONQUEUE_H
@@ -0,0 +1,628 @@
+/*
+
+    Copyright (C) 2013  Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+
+#include "filesearch.h"
+#include "fileindex.h"
+#include "contentmatcher_p.h"
+#include <QThreadPool>
+#include <QRunnable>
+#include <QMutexLocker>
+#include <QUrl>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+// buffer of the dir entries read by one getdents64() call
+#define DIRENT_BUFFER_SIZE  (32 * 1024)
+#define MAX_WORKER_THREADS  8
+// number of files handled by one task. reading the content takes much
+// longer than loading the file info, so fewer files are given to a task.
+#define INFO_BATCH_SIZE     256
+#define CONTENT_BATCH_SIZE  16
+// files larger than this are not searched for the content by default
+#define MAX_CONTENT_SIZE    (64 * 1024 * 1024)
+
+namespace Fm {
+
+#ifdef __linux__
+// glibc does not export this, so we call getdents64 ourselves to
+// read many entries in one system call without going through DIR*.
+struct LinuxDirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[1];
+};
+#endif
+
+// read one dir in a worker thread
+class FileSearch::DirTask : public QRunnable {
+public:
+  DirTask(FileSearch* search, const QByteArray& path):
+    search_(search),
+    path_(path) {
+  }
+
+  virtual void run() {
+    search_->searchDir(path_);
+    search_->taskDone();
+  }
+
+private:
+  FileSearch* search_;
+  QByteArray path_;
+};
+
+// check the content and load the info of the files found in the
+// file index or picked by the walker in a worker thread
+class FileSearch::FileTask : public QRunnable {
+public:
+  FileTask(FileSearch* search, const QList<QByteArray>& paths):
+    search_(search),
+    paths_(paths) {
+  }
+
+  virtual void run() {
+    QList<FoundFile> results;
+    const ContentMatcher* matcher = search_->contentMatcher_;
+    Q_FOREACH(const QByteArray& path, paths_) {
+      if(search_->cancelled_.fetchAndAddOrdered(0))
+        break;
+      FoundFile found;
+      found.matches = -1;
+      // most files do not contain the text, so the content is checked
+      // before loading the file info unless the MIME type is needed.
+      if(matcher && search_->mimeGlobs_.isEmpty()) {
+        found.matches = matcher->countMatches(path.constData());
+        if(found.matches <= 0)
+          continue;
+      }
+      found.info = search_->loadFileInfo(path);
+      if(!found.info)
+        continue;
+      // the file might be changed after it's indexed
+      if(!search_->matchStat(fm_file_info_is_dir(found.info), fm_file_info_get_size(found.info), fm_file_info_get_mtime(found.info))) {
+        fm_file_info_unref(found.info);
+        continue;
+      }
+      if(matcher && found.matches < 0) {
+        found.matches = matcher->countMatches(path.constData());
+        if(found.matches <= 0) {
+          fm_file_info_unref(found.info);
+          continue;
+        }
+      }
+      results.append(found);
+    }
+    if(!results.isEmpty())
+      search_->addResults(results);
+    search_->taskDone();
+  }
+
+private:
+  FileSearch* search_;
+  QList<QByteArray> paths_;
+};
+
+// match the names in the file index in a worker thread.
+// the index is implicitly shared, so the copy it holds is not changed by the main thread.
+class FileSearch::IndexTask : public QRunnable {
+public:
+  IndexTask(FileSearch* search, const FileIndex::DirMap& dirs, const QList<QByteArray>& paths):
+    search_(search),
+    dirs_(dirs),
+    paths_(paths) {
+  }
+
+  virtual void run() {
+    search_->searchIndexDirs(dirs_, paths_);
+    search_->taskDone();
+  }
+
+private:
+  FileSearch* search_;
+  FileIndex::DirMap dirs_;
+  QList<QByteArray> paths_;
+};
+
+FileSearch::FileSearch(QObject* parent):
+  QObject(parent),
+  nameCaseInsensitive_(false),
+  nameRegExp_(false),
+  recursive_(true),
+  showHidden_(false),
+  minSize_(-1),
+  maxSize_(-1),
+  minMtime_(-1),
+  maxMtime_(-1),
+  contentCaseInsensitive_(false),
+  contentRegExp_(false),
+  maxContentSize_(MAX_CONTENT_SIZE),
+  contentMatcher_(NULL),
+  running_(false),
+  pool_(new QThreadPool()),
+  cancelled_(0),
+  activeTasks_(0),
+  scannedDirs_(0) {
+  pool_->setMaxThreadCount(MAX_WORKER_THREADS);
+}
+
+FileSearch::~FileSearch() {
+  cancel();
+  delete pool_;
+  delete contentMatcher_;
+}
+
+// static
+bool FileSearch::isSearchPath(FmPath* path) {
+  char* uri = fm_path_to_uri(path);
+  bool ret = g_str_has_prefix(uri, "search:");
+  g_free(uri);
+  return ret;
+}
+
+bool FileSearch::setPath(FmPath* path) {
+  char* uri = fm_path_to_uri(path);
+  QByteArray str = uri;
+  g_free(uri);
+  if(!str.startsWith("search:"))
+    return false;
+  str.remove(0, 7);
+  if(str.startsWith("//"))
+    str.remove(0, 2);
+
+  int sep = str.indexOf('?');
+  QByteArray paths = sep >= 0 ? str.left(sep) : str;
+  QByteArray query = sep >= 0 ? str.mid(sep + 1) : QByteArray();
+
+  searchPaths_.clear();
+  Q_FOREACH(const QByteArray& item, paths.split(',')) {
+    if(!item.isEmpty())
+      searchPaths_.append(QUrl::fromPercentEncoding(item));
+  }
+  if(searchPaths_.isEmpty())
+    return false;
+
+  Q_FOREACH(const QByteArray& item, query.split('&')) {
+    int eq = item.indexOf('=');
+    if(eq < 0)
+      continue;
+    QByteArray key = item.left(eq);
+    QString value = QUrl::fromPercentEncoding(item.mid(eq + 1));
+    if(key == "name" || key == "name_regex") {
+      namePattern_ = value;
+      nameRegExp_ = (key == "name_regex");
+    }
+    else if(key == "name_ci")
+      nameCaseInsensitive_ = (value == "1");
+    else if(key == "recursive")
+      recursive_ = (value == "1");
+    else if(key == "show_hidden")
+      showHidden_ = (value == "1");
+    else if(key == "mime_types")
+      mimeTypes_ = value.split(';', QString::SkipEmptyParts);
+    else if(key == "min_size")
+      minSize_ = value.toLongLong();
+    else if(key == "max_size")
+      maxSize_ = value.toLongLong();
+    else if(key == "min_mtime" || key == "max_mtime") {
+      // toTime_t() returns uint(-1) for invalid dates and ones before 1970.
+      // keep -1 (not limited) then, rather than filtering out every file.
+      QDateTime time = QDateTime::fromString(value, Qt::ISODate);
+      uint secs = time.isValid() ? time.toTime_t() : uint(-1);
+      qint64 t = (secs != uint(-1)) ? qint64(secs) : -1;
+      if(key == "min_mtime")
+        minMtime_ = t;
+      else
+        maxMtime_ = t;
+    }
+    else if(key == "content" || key == "content_regex") {
+      contentPattern_ = value;
+      contentRegExp_ = (key == "content_regex");
+    }
+    else if(key == "content_ci")
+      contentCaseInsensitive_ = (value == "1");
+    else if(key == "max_content_size")
+      maxContentSize_ = qMax(value.toLongLong(), qint64(-1)); // -1 means not limited
+  }
+  return true;
+}
+
+FmPath* FileSearch::path() const {
+  QByteArray uri = "search://";
+  for(int i = 0; i < searchPaths_.size(); ++i) {
+    if(i > 0)
+      uri += ',';
+    uri += QUrl::toPercentEncoding(searchPaths_[i], "/");
+  }
+
+  QList<QByteArray> query;
+  if(!namePattern_.isEmpty())
+    query.append((nameRegExp_ ? "name_regex=" : "name=") + QUrl::toPercentEncoding(namePattern_));
+  if(nameCaseInsensitive_)
+    query.append("name_ci=1");
+  query.append(recursive_ ? "recursive=1" : "recursive=0");
+  if(showHidden_)
+    query.append("show_hidden=1");
+  if(!mimeTypes_.isEmpty())
+    query.append("mime_types=" + QUrl::toPercentEncoding(mimeTypes_.join(";"), "/*"));
+  if(minSize_ >= 0)
+    query.append("min_size=" + QByteArray::number(minSize_));
+  if(maxSize_ >= 0)
+    query.append("max_size=" + QByteArray::number(maxSize_));
+  if(minMtime_ >= 0)
+    query.append("min_mtime=" + QUrl::toPercentEncoding(QDateTime::fromTime_t(minMtime_).toString(Qt::ISODate)));
+  if(maxMtime_ >= 0)
+    query.append("max_mtime=" + QUrl::toPercentEncoding(QDateTime::fromTime_t(maxMtime_).toString(Qt::ISODate)));
+  if(!contentPattern_.isEmpty()) {
+    query.append((contentRegExp_ ? "content_regex=" : "content=") + QUrl::toPercentEncoding(contentPattern_));
+    if(contentCaseInsensitive_)
+      query.append("content_ci=1");
+    if(maxContentSize_ != MAX_CONTENT_SIZE)
+      query.append("max_content_size=" + QByteArray::number(maxContentSize_));
+  }
+
+  uri += '?';
+  for(int i = 0; i < query.size(); ++i) {
+    if(i > 0)
+      uri += '&';
+    uri += query[i];
+  }
+  return fm_path_new_for_uri(uri.constData());
+}
+
+void FileSearch::start() {
+  if(running_ || cancelled_.fetchAndAddOrdered(0))
+    return;
+
+  // compile the conditions once so the workers only need to compare
+  nameGlob_.clear();
+  nameRe_ = QRegExp();
+  if(!namePattern_.isEmpty()) {
+    if(nameRegExp_)
+      nameRe_ = QRegExp(namePattern_, nameCaseInsensitive_ ? Qt::CaseInsensitive : Qt::CaseSensitive, QRegExp::RegExp2);
+    else {
+      nameGlob_ = QFile::encodeName(namePattern_);
+      if(!nameGlob_.contains('*') && !nameGlob_.contains('?') && !nameGlob_.contains('['))
+        nameGlob_ = '*' + nameGlob_ + '*';
+    }
+  }
+  mimeGlobs_.clear();
+  Q_FOREACH(const QString& type, mimeTypes_)
+    mimeGlobs_.append(type.toLatin1());
+  if(!contentPattern_.isEmpty())
+    contentMatcher_ = new ContentMatcher(contentPattern_, contentCaseInsensitive_, contentRegExp_, maxContentSize_);
+
+  running_ = true;
+  QList<QByteArray> paths;
+  Q_FOREACH(const QString& path, searchPaths_) {
+    // symlinks are not followed during the walk, but the dirs given by the user are.
+    QString realPath = QFileInfo(path).canonicalFilePath();
+    if(!realPath.isEmpty())
+      paths.append(QFile::encodeName(realPath));
+  }
+  if(!searchIndex(paths)) {
+    Q_FOREACH(const QByteArray& path, paths)
+      queueDir(path);
+  }
+  if(activeTasks_.fetchAndAddOrdered(0) == 0) { // nothing to search
+    running_ = false;
+    QMetaObject::invokeMethod(this, "finished", Qt::QueuedConnection);
+  }
+}
+
+void FileSearch::cancel() {
+  if(!running_)
+    return;
+  cancelled_.fetchAndStoreOrdered(1);
+  pool_->waitForDone();
+  freeResults();
+  running_ = false;
+}
+
+int FileSearch::scannedDirs() {
+  return scannedDirs_.fetchAndAddOrdered(0);
+}
+
+// called from the worker threads when a task is finished
+void FileSearch::taskDone() {
+  if(!activeTasks_.deref()) // this is the last one
+    QMetaObject::invokeMethod(this, "onWalkFinished", Qt::QueuedConnection);
+}
+
+void FileSearch::queueDir(const QByteArray& path) {
+  activeTasks_.ref();
+  pool_->start(new DirTask(this, path));
+}
+
+// the files are split among the worker threads, so the content of many files is read in parallel
+void FileSearch::queueFiles(const QList<QByteArray>& paths) {
+  int batchSize = contentMatcher_ ? CONTENT_BATCH_SIZE : INFO_BATCH_SIZE;
+  for(int i = 0; i < paths.size(); i += batchSize) {
+    activeTasks_.ref();
+    pool_->start(new FileTask(this, paths.mid(i, batchSize)));
+  }
+}
+
+// called from the worker threads
+void FileSearch::searchDir(const QByteArray& path) {
+  if(cancelled_.fetchAndAddOrdered(0))
+    return;
+  int fd = openat(AT_FDCWD, path.constData(), O_RDONLY|O_DIRECTORY|O_NOFOLLOW|O_CLOEXEC);
+  if(fd < 0)
+    return;
+
+  DirScan scan;
+  scan.nameRe = nameRe_;
+
+#ifdef __linux__
+  char buf[DIRENT_BUFFER_SIZE];
+  long n;
+  while(!cancelled_.fetchAndAddOrdered(0) && (n = syscall(SYS_getdents64, fd, buf, sizeof(buf))) > 0) {
+    for(long pos = 0; pos < n;) {
+      LinuxDirent64* ent = reinterpret_cast<LinuxDirent64*>(buf + pos);
+      pos += ent->d_reclen;
+      checkEntry(fd, path, ent->d_name, ent->d_type, scan);
+    }
+  }
+  close(fd);
+#else
+  DIR* dir = fdopendir(fd);
+  if(!dir) {
+    close(fd);
+    return;
+  }
+  struct dirent* ent;
+  while(!cancelled_.fetchAndAddOrdered(0) && (ent = readdir(dir)))
+    checkEntry(fd, path, ent->d_name, ent->d_type, scan);
+  closedir(dir);
+#endif
+
+  scannedDirs_.ref();
+  if(!scan.results.isEmpty())
+    addResults(scan.results);
+  queueFiles(scan.candidates);
+  // the dir is closed before the sub dirs are queued, so only a few fds are open at a time.
+  Q_FOREACH(const QByteArray& subDir, scan.subDirs)
+    queueDir(subDir);
+}
+
+void FileSearch::checkEntry(int dirFd, const QByteArray& path, const char* name, unsigned char type, DirScan& scan) {
+  if(name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+    return;
+  if(!showHidden_ && name[0] == '.')
+    return;
+  bool isDir = (type == DT_DIR);
+  if(type == DT_UNKNOWN) { // some file systems don't fill d_type
+    struct stat st;
+    isDir = (fstatat(dirFd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode));
+  }
+  if(isDir && recursive_)
+    scan.subDirs.append(path.endsWith('/') ? path + name : path + '/' + name);
+  checkFile(dirFd, path, name, isDir, scan);
+}
+
+// check the cheap conditions first, so the file info is only loaded for
+// the files likely to match. called from the worker threads.
+bool FileSearch::checkFile(int dirFd, const QByteArray& path, const char* name, bool isDir, DirScan& scan) {
+  if(!matchName(name, scan.nameRe))
+    return false;
+  if(hasStatConditions()) {
+    struct stat st;
+    if(fstatat(dirFd, name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+      return false;
+    if(!matchStat(isDir, st.st_size, st.st_mtime))
+      return false;
+  }
+  QByteArray fullPath = path.endsWith('/') ? path + name : path + '/' + name;
+  if(contentMatcher_) { // dirs have no content to match
+    if(isDir)
+      return false;
+    scan.candidates.append(fullPath);
+    return true;
+  }
+  FoundFile found;
+  found.info = loadFileInfo(fullPath);
+  found.matches = -1;
+  if(!found.info)
+    return false;
+  scan.results.append(found);
+  return true;
+}
+
+bool FileSearch::matchName(const char* name, QRegExp& nameRe) const {
+  if(!nameGlob_.isEmpty()) {
+    int flags = 0;
+#ifdef FNM_CASEFOLD
+    if(nameCaseInsensitive_)
+      flags |= FNM_CASEFOLD;
+#endif
+    return fnmatch(nameGlob_.constData(), name, flags) == 0;
+  }
+  if(!nameRe.isEmpty())
+    return nameRe.indexIn(QFile::decodeName(name)) >= 0;
+  return true;
+}
+
+bool FileSearch::hasStatConditions() const {
+  return minSize_ >= 0 || maxSize_ >= 0 || minMtime_ >= 0 || maxMtime_ >= 0;
+}
+
+bool FileSearch::matchStat(bool isDir, qint64 size, qint64 mtime) const {
+  if(minSize_ >= 0 || maxSize_ >= 0) {
+    if(isDir)
+      return false;
+    if((minSize_ >= 0 && size < minSize_) || (maxSize_ >= 0 && size > maxSize_))
+      return false;
+  }
+  if((minMtime_ >= 0 && mtime < minMtime_) || (maxMtime_ >= 0 && mtime > maxMtime_))
+    return false;
+  return true;
+}
+
+// load the file info and check the MIME type.
+// returns NULL if the file does not match. called from the worker threads.
+FmFileInfo* FileSearch::loadFileInfo(const QByteArray& fullPath) {
+  FmPath* fmPath = fm_path_new_for_path(fullPath.constData());
+  FmFileInfo* info = fm_file_info_new();
+  fm_file_info_set_path(info, fmPath);
+  fm_path_unref(fmPath);
+  if(!fm_file_info_set_from_native_file(info, fullPath.constData(), NULL)) {
+    fm_file_info_unref(info);
+    return NULL;
+  }
+
+  if(!mimeGlobs_.isEmpty()) {
+    FmMimeType* mimeType = fm_file_info_get_mime_type(info);
+    const char* type = mimeType ? fm_mime_type_get_type(mimeType) : NULL;
+    bool matched = false;
+    if(type) {
+      Q_FOREACH(const QByteArray& glob, mimeGlobs_) {
+        if(fnmatch(glob.constData(), type, 0) == 0) {
+          matched = true;
+          break;
+        }
+      }
+    }
+    if(!matched) {
+      fm_file_info_unref(info);
+      return NULL;
+    }
+  }
+  return info;
+}
+
+// find the names in the file index instead of reading the dirs.
+// only the matching files are read to load their file info.
+// returns false if the index does not cover all the dirs to search.
+bool FileSearch::searchIndex(const QList<QByteArray>& paths) {
+  FileIndex* index = FileIndex::defaultIndex();
+  // hidden dirs are not indexed
+  if(!index || showHidden_)
+    return false;
+  Q_FOREACH(const QByteArray& path, paths) {
+    if(!index->covers(path))
+      return false;
+  }
+  // matching many names takes a while, so it's done in a worker thread, too.
+  activeTasks_.ref();
+  pool_->start(new IndexTask(this, index->dirs(), paths));
+  return true;
+}
+
+// called from the worker threads
+void FileSearch::searchIndexDirs(const FileIndex::DirMap& dirs, const QList<QByteArray>& paths) {
+  QRegExp nameRe = nameRe_;
+  QList<QByteArray> found;
+  Q_FOREACH(const QByteArray& path, paths) {
+    if(cancelled_.fetchAndAddOrdered(0))
+      return;
+    FileIndex::DirMap::const_iterator it = dirs.constFind(path);
+    if(it != dirs.constEnd())
+      searchIndexDir(it.key(), it.value(), nameRe, found);
+    if(recursive_) {
+      // the sub dirs are sorted right after the dir
+      QByteArray prefix = path.endsWith('/') ? path : path + '/';
+      for(it = dirs.lowerBound(prefix); it != dirs.constEnd() && it.key().startsWith(prefix); ++it)
+        searchIndexDir(it.key(), it.value(), nameRe, found);
+    }
+  }
+
+  // the index might be outdated, so the files are checked again while loading their info.
+  queueFiles(found);
+}
+
+void FileSearch::searchIndexDir(const QByteArray& path, const FileIndex::Dir& dir, QRegExp& nameRe, QList<QByteArray>& found) {
+  scannedDirs_.ref();
+  Q_FOREACH(const FileIndex::Entry& entry, dir.entries) {
+    const char* name = dir.name(entry);
+    bool isDir = (entry.flags & FileIndex::EntryIsDir) != 0;
+    if(name[0] == '.' || (isDir && contentMatcher_))
+      continue;
+    if(!matchName(name, nameRe) || !matchStat(isDir, entry.size, entry.mtime))
+      continue;
+    found.append(path.endsWith('/') ? path + name : path + '/' + name);
+  }
+}
+
+// pass the found files to the main thread. they are collected until
+// the main thread gets to them, so a busy main thread gets larger batches.
+void FileSearch::addResults(const QList<FoundFile>& results) {
+  QMutexLocker locker(&lock_);
+  bool wasEmpty = pending_.isEmpty();
+  pending_ += results;
+  if(wasEmpty)
+    QMetaObject::invokeMethod(this, "flushResults", Qt::QueuedConnection);
+}
+
+void FileSearch::freeResults() {
+  QMutexLocker locker(&lock_);
+  Q_FOREACH(const FoundFile& found, pending_)
+    fm_file_info_unref(found.info);
+  pending_.clear();
+}
+
+void FileSearch::flushResults() {
+  QList<FoundFile> results;
+  {
+    QMutexLocker locker(&lock_);
+    results = pending_;
+    pending_.clear();
+  }
+  if(results.isEmpty() || cancelled_.fetchAndAddOrdered(0)) {
+    Q_FOREACH(const FoundFile& found, results)
+      fm_file_info_unref(found.info);
+    return;
+  }
+
+  FmFileInfoList* files = fm_file_info_list_new();
+  Q_FOREACH(const FoundFile& found, results) {
+    fm_file_info_list_push_tail(files, found.info);
+    // the list holds a reference, and so does the model receiving the files
+    if(found.matches >= 0)
+      matchCounts_.insert(found.info, found.matches);
+    fm_file_info_unref(found.info);
+  }
+  Q_EMIT filesFound(files);
+  fm_file_info_list_unref(files);
+}
+
+void FileSearch::onWalkFinished() {
+  if(!running_ || activeTasks_.fetchAndAddOrdered(0) != 0)
+    return;
+  flushResults();
+  running_ = false;
+  Q_EMIT finished();
+}
+
+}
@@ -0,0 +1,276 @@
+/*
+
+    Copyright (C) 2013  Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+
+#ifndef FM_FILESEARCH_H
+#define FM_FILESEARCH_H
+
+#include "libfmqtglobals.h"
+#include "fileindex.h"
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QList>
+#include <QRegExp>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QHash>
+#include <libfm/fm.h>
+
+class QThreadPool;
+
+namespace Fm {
+
+class ContentMatcher;
+
+// Searches local dirs for files matching the given conditions.
+// The dirs are read in parallel by a pool of worker threads, and the
+// matching files are delivered to the main thread in batches with the
+// filesFound() signal while the search is still going on.
+// The conditions can be converted to and from a search:// URI so
+// the search can be opened like a folder.
+// If the default FileIndex covers the dirs, the names are looked up in
+// the index, and only the matching files are read from the disk.
+class LIBFM_QT_API FileSearch : public QObject {
+Q_OBJECT
+public:
+  explicit FileSearch(QObject* parent = 0);
+  virtual ~FileSearch();
+
+  // the URI has the form search:///dir1,/dir2?key=value&key=value
+  static bool isSearchPath(FmPath* path);
+  bool setPath(FmPath* path);
+  FmPath* path() const; // the returned path should be freed with fm_path_unref()
+
+  // local dirs to search in
+  QStringList searchPaths() const {
+    return searchPaths_;
+  }
+  void setSearchPaths(const QStringList& paths) {
+    searchPaths_ = paths;
+  }
+
+  // a wildcard pattern, or a regular expression if nameRegExp is set.
+  // a pattern without wildcards matches the names containing it.
+  QString namePattern() const {
+    return namePattern_;
+  }
+  void setNamePattern(const QString& pattern) {
+    namePattern_ = pattern;
+  }
+
+  bool nameCaseInsensitive() const {
+    return nameCaseInsensitive_;
+  }
+  void setNameCaseInsensitive(bool value) {
+    nameCaseInsensitive_ = value;
+  }
+
+  bool nameRegExp() const {
+    return nameRegExp_;
+  }
+  void setNameRegExp(bool value) {
+    nameRegExp_ = value;
+  }
+
+  bool recursive() const {
+    return recursive_;
+  }
+  void setRecursive(bool value) {
+    recursive_ = value;
+  }
+
+  bool showHidden() const {
+    return showHidden_;
+  }
+  void setShowHidden(bool value) {
+    showHidden_ = value;
+  }
+
+  // wildcard patterns of mime types, such as image/*
+  QStringList mimeTypes() const {
+    return mimeTypes_;
+  }
+  void setMimeTypes(const QStringList& types) {
+    mimeTypes_ = types;
+  }
+
+  // size limits in bytes, -1 if not limited. dirs never match if set.
+  qint64 minSize() const {
+    return minSize_;
+  }
+  void setMinSize(qint64 size) {
+    minSize_ = size;
+  }
+
+  qint64 maxSize() const {
+    return maxSize_;
+  }
+  void setMaxSize(qint64 size) {
+    maxSize_ = size;
+  }
+
+  // limits of the last modified time in seconds since the epoch, -1 if not limited
+  qint64 minMtime() const {
+    return minMtime_;
+  }
+  void setMinMtime(qint64 time) {
+    minMtime_ = time;
+  }
+
+  qint64 maxMtime() const {
+    return maxMtime_;
+  }
+  void setMaxMtime(qint64 time) {
+    maxMtime_ = time;
+  }
+
+  // text to find in the content of the files. it's a plain string,
+  // or a regular expression if contentRegExp is set.
+  QString contentPattern() const {
+    return contentPattern_;
+  }
+  void setContentPattern(const QString& pattern) {
+    contentPattern_ = pattern;
+  }
+
+  bool contentCaseInsensitive() const {
+    return contentCaseInsensitive_;
+  }
+  void setContentCaseInsensitive(bool value) {
+    contentCaseInsensitive_ = value;
+  }
+
+  bool contentRegExp() const {
+    return contentRegExp_;
+  }
+  void setContentRegExp(bool value) {
+    contentRegExp_ = value;
+  }
+
+  // files larger than this are not searched for the content, -1 if not limited
+  qint64 maxContentSize() const {
+    return maxContentSize_;
+  }
+  void setMaxContentSize(qint64 size) {
+    maxContentSize_ = size;
+  }
+
+  // number of the content matches in a found file, or -1 if the content is not searched
+  int matchCount(FmFileInfo* info) const {
+    return matchCounts_.value(info, -1);
+  }
+
+  // start the search. a FileSearch object can only be started once.
+  void start();
+  // stop the search and wait for the worker threads to quit
+  void cancel();
+
+  bool isRunning() const {
+    return running_;
+  }
+
+  // number of dirs read so far
+  int scannedDirs();
+
+Q_SIGNALS:
+  // a batch of matching files is found. the list is freed after the signal.
+  void filesFound(FmFileInfoList* files);
+  // the search is done. it's not emitted if the search is cancelled.
+  void finished();
+
+private Q_SLOTS:
+  void flushResults();
+  void onWalkFinished();
+
+private:
+  class DirTask;
+  friend class DirTask;
+  class FileTask;
+  friend class FileTask;
+  class IndexTask;
+  friend class IndexTask;
+
+  struct FoundFile {
+    FmFileInfo* info;
+    int matches;
+  };
+
+  // the state of reading a dir in a worker thread
+  struct DirScan {
+    QRegExp nameRe;
+    QList<FoundFile> results;
+    QList<QByteArray> subDirs;
+    QList<QByteArray> candidates; // files whose content should be checked
+  };
+
+  void taskDone();
+  void queueDir(const QByteArray& path);
+  void queueFiles(const QList<QByteArray>& paths);
+  void searchDir(const QByteArray& path);
+  void checkEntry(int dirFd, const QByteArray& path, const char* name, unsigned char type, DirScan& scan);
+  bool checkFile(int dirFd, const QByteArray& path, const char* name, bool isDir, DirScan& scan);
+  bool matchName(const char* name, QRegExp& nameRe) const;
+  bool hasStatConditions() const;
+  bool matchStat(bool isDir, qint64 size, qint64 mtime) const;
+  FmFileInfo* loadFileInfo(const QByteArray& fullPath);
+  bool searchIndex(const QList<QByteArray>& paths);
+  void searchIndexDirs(const FileIndex::DirMap& dirs, const QList<QByteArray>& paths);
+  void searchIndexDir(const QByteArray& path, const FileIndex::Dir& dir, QRegExp& nameRe, QList<QByteArray>& found);
+  void addResults(const QList<FoundFile>& results);
+  void freeResults();
+
+private:
+  QStringList searchPaths_;
+  QString namePattern_;
+  bool nameCaseInsensitive_;
+  bool nameRegExp_;
+  bool recursive_;
+  bool showHidden_;
+  QStringList mimeTypes_;
+  qint64 minSize_;
+  qint64 maxSize_;
+  qint64 minMtime_;
+  qint64 maxMtime_;
+  QString contentPattern_;
+  bool contentCaseInsensitive_;
+  bool contentRegExp_;
+  qint64 maxContentSize_;
+
+  // compiled conditions used by the worker threads
+  QByteArray nameGlob_;
+  QRegExp nameRe_; // copied by each task since QRegExp cannot be shared among threads
+  QList<QByteArray> mimeGlobs_;
+  ContentMatcher* contentMatcher_;
+
+  bool running_;
+  QThreadPool* pool_;
+  QAtomicInt cancelled_;
+  QAtomicInt activeTasks_;
+  QAtomicInt scannedDirs_;
+  QMutex lock_;
+  QList<FoundFile> pending_; // found files not yet delivered to the main thread
+  QHash<FmFileInfo*, int> matchCounts_;
+};
+
+}
+
+#endif // FM_FILESEARCH_H
@@ -79,8 +79,17 @@ FolderMenu::~FolderMenu() {
 }
 
 void FolderMenu::createCreateNewMenu() {
-  QMenu* createMenu = new QMenu(this);
-  createNewMenu_ = createMenu;
+  createNewMenu_ = new QMenu(this);
+  // the templates are loaded when the menu is shown for the first time
+  createNewMenuLoaded_ = false;
+  connect(createNewMenu_, SIGNAL(aboutToShow()), SLOT(onCreateNewMenuAboutToShow()));
+}
+
+void FolderMenu::onCreateNewMenuAboutToShow() {
+  if(createNewMenuLoaded_)
+    return;
+  createNewMenuLoaded_ = true;
+  QMenu* createMenu = createNewMenu_;
 
   QAction* action = new QAction(tr("Folder"), this);
   connect(action, SIGNAL(triggered(bool)), SLOT(onCreateNewFolder()));
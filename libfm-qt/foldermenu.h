@@ -92,6 +92,7 @@ protected Q_SLOTS:
   void onCreateNewFolder();
   void onCreateNewFile();
   void onCreateNew();
+  void onCreateNewMenuAboutToShow();
 
   void onPasteActionTriggered();
   void onSelectAllActionTriggered();
@@ -112,6 +113,7 @@ private:
   FolderView* view_;
   QAction* createAction_;
   QMenu* createNewMenu_;
+  bool createNewMenuLoaded_;
   QAction* separator1_;
   QAction* pasteAction_;
   QAction* separator2_;
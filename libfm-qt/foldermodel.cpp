@@ -259,7 +259,8 @@ QVariant FolderModel::headerData(int section, Qt::Orientation orientation, int r
 }
 
 QModelIndex FolderModel::index(int row, int column, const QModelIndex & parent) const {
-  if(row <0 || row >= items.size() || column < 0 || column >= NumOfColumns)
+  // subclasses may add more columns
+  if(row <0 || row >= items.size() || column < 0 || column >= columnCount(parent))
     return QModelIndex();
   const FolderModelItem& item = items.at(row);
   return createIndex(row, column, (void*)&item);
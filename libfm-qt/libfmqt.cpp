@@ -22,6 +22,8 @@
 #include <QLocale>
 #include "icontheme.h"
 #include "thumbnailloader.h"
+#include "appmenumodel_p.h"
+#include "appinfocache_p.h"
 
 namespace Fm {
 	
@@ -50,6 +52,8 @@ LibFmQtData::LibFmQtData(): refCount(1) {
 }
 
 LibFmQtData::~LibFmQtData() {
+  AppMenuModel::freeSharedModel();
+  AppInfoCache::freeSharedCache();
   delete iconTheme;
   delete thumbnailLoader;
   fm_finalize();
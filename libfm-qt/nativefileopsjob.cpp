@@ -0,0 +1,1350 @@
+/*
+
+    Copyright (C) 2013  Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+
+#include "nativefileopsjob_p.h"
+#include "fileoperationjournal.h"
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSemaphore>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QAtomicInt>
+#include <QHash>
+#include <QFile>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <sys/xattr.h>
+#include <linux/fs.h>
+#endif
+
+// amount of data copied by the kernel in one call.
+// progress is updated and cancellation is checked after each chunk.
+#define COPY_CHUNK_SIZE     (16 * 1024 * 1024)
+// buffer used when the kernel cannot copy the data for us
+#define COPY_BUFFER_SIZE    (1024 * 1024)
+// min interval of "cur-file" signals in microseconds
+#define CUR_FILE_INTERVAL   (100 * 1000)
+// files smaller than this are copied in parallel by the worker threads.
+// larger ones are bound by disk bandwidth rather than per-file latency.
+#define SMALL_FILE_SIZE     (1024 * 1024)
+#define MAX_WORKER_THREADS  8
+// max number of small files waiting for the workers
+#define MAX_QUEUED_FILES    256
+// max number of dirs kept open by the dirs being deleted in parallel.
+// well below the default limit of 1024 fds.
+#define MAX_OPEN_DIRS       256
+// number of files moved to the trash can between progress updates
+#define TRASH_BATCH_SIZE    256
+
+enum {
+  RESOLVE_CONFLICTS,
+  N_SIGNALS
+};
+
+static guint signals[N_SIGNALS];
+
+// emit "resolve-conflicts" in the main thread
+static gpointer emitResolveConflicts(FmJob* job, gpointer conflicts) {
+  g_signal_emit(job, signals[RESOLVE_CONFLICTS], 0, conflicts);
+  return NULL;
+}
+
+namespace Fm {
+
+// Copy and move local files in the worker thread of a FmNativeFileOpsJob.
+// The job thread walks the source trees, creates the dirs, and copies large
+// files itself. Small files are handed to a pool of worker threads, since
+// copying them is bound by the latency of creating files rather than by
+// bandwidth. A dir is always created before its content is queued, and its
+// mode and times are restored (or the source removed for moves) only after
+// all of its content is done.
+// Files which already exist in the destination are held, and resolved all
+// at once after everything else is done, so copying never waits for the user.
+// Deleting works the same way: dirs are handed to the workers, files are
+// removed with unlinkat(), and a dir is removed after all of its content.
+// Files in the file system of the home trash can are trashed by renaming
+// them into it and writing the trash info files ourselves, in batches.
+class NativeFileOps {
+public:
+  enum Result {
+    Done,
+    Skipped,
+    Failed,
+    Pending // the work is queued, the result is reported to the parent dir later
+  };
+
+  explicit NativeFileOps(FmFileOpsJob* job);
+  ~NativeFileOps();
+
+  static bool canHandle(FmFileOpsJob* job);
+  bool run();
+
+private:
+  struct Source {
+    QByteArray path;
+    struct stat st;
+  };
+
+  // a dir whose content is being copied
+  struct DirNode {
+    QByteArray src;
+    QByteArray dest;
+    struct stat st;
+    bool merge;
+    bool move;
+    DirNode* parent;
+    // used by deleting. the sub dirs are opened and removed relative to fd of
+    // their parent, which is kept open until all of its children are done.
+    QByteArray name;
+    int fd;
+    bool fdSlot; // holds one of dirFdSlots_, so its sub dirs may be queued
+    QAtomicInt pending; // number of unfinished children, plus one held by the walker
+    QAtomicInt failed;
+  };
+
+  // a file being moved to the trash can
+  struct TrashItem {
+    QByteArray src;
+    QByteArray dest; // path in Trash/files
+    QByteArray info; // path of the trash info file
+  };
+
+  // a file held because the destination exists
+  struct Conflict {
+    QByteArray src;
+    struct stat st;
+    QByteArray dest;
+    struct stat destSt;
+    bool move;
+    DirNode* parent;
+  };
+
+  class CopyTask;
+  friend class CopyTask;
+  class DeleteTask;
+  friend class DeleteTask;
+
+  bool isCancelled() {
+    return fm_job_is_cancelled(FM_JOB(job_));
+  }
+
+  static QByteArray childPath(const QByteArray& dir, const char* name) {
+    return dir.endsWith('/') ? dir + name : dir + '/' + name;
+  }
+
+  bool runTransfer();
+  bool runDelete();
+  bool runTrash();
+  bool reserveTrashName(const QByteArray& src, const QByteArray& trashDir, const char* date, QHash<QByteArray, int>& nextSuffix, TrashItem& item);
+  void trashWithGio(const QByteArray& src);
+  goffset countTree(const QByteArray& path, const struct stat& st);
+  Result transferItem(const QByteArray& src, const struct stat& st, const QByteArray& destPath, bool move, DirNode* parent);
+  Result transferTo(const QByteArray& src, const struct stat& st, const QByteArray& dest, bool merge, bool move, DirNode* parent);
+  bool prepareOverwrite(const QByteArray& src, const struct stat& st, const QByteArray& dest, const struct stat& destSt, bool& merge);
+  Result skipItem(const QByteArray& src, const struct stat& st, bool move);
+  void holdConflict(const QByteArray& src, const struct stat& st, const QByteArray& dest, const struct stat& destSt, bool move, DirNode* parent);
+  void resolveConflicts();
+  Result resolveConflict(const Conflict& conflict, FmFileOpOption action, const QString& newName);
+  static QByteArray freeName(const QByteArray& path);
+  bool isFinishedBefore(const QByteArray& src, const struct stat& st, const struct stat& destSt);
+  bool isLeftBehind(const QByteArray& dest, const struct stat& destSt);
+  void journalFile(const QByteArray& src, const struct stat& st) {
+    if(journal_)
+      journal_->addFinishedFile(src, st);
+  }
+  // recorded after the file is created with O_EXCL or alike, so a file
+  // which existed before is never taken for one created by us.
+  void journalCreated(const QByteArray& dest) {
+    if(journal_)
+      journal_->addCreatedFile(dest);
+  }
+  Result copyDir(const QByteArray& src, const struct stat& st, const QByteArray& dest, bool merge, bool move, DirNode* parent);
+  void finishChild(DirNode* node, Result result);
+  Result finishDir(DirNode* node);
+  DirNode* newDeleteNode(const QByteArray& path, const char* name, DirNode* parent);
+  void deleteDir(DirNode* node);
+  void updateDeleteProgress();
+  Result copyFile(const QByteArray& src, const struct stat& st, const QByteArray& dest);
+  Result copyRegularFile(const QByteArray& src, const struct stat& st, const QByteArray& dest);
+  bool copyData(int srcFd, int destFd, goffset size, goffset& copied);
+  void copyMetadata(int srcFd, int destFd, const struct stat& st);
+  void setTimes(const QByteArray& path, const struct stat& st);
+
+  FmFileOpOption askRename(const QByteArray& src, const QByteArray& dest, QByteArray& newDest);
+  bool reportError(const QByteArray& path, int errnum);
+  void emitError(GError* err);
+  void setCurFile(const QByteArray& path);
+  void addFinished(goffset size);
+
+private:
+  FmFileOpsJob* job_;
+  FileOperationJournal* journal_;
+  dev_t destDev_;
+  gint64 lastCurFileTime_;
+  QThreadPool* pool_;
+  QSemaphore queueSlots_; // limits the number of queued small files
+  QSemaphore dirFdSlots_; // limits the number of dirs kept open while deleting
+  // serializes calls into the main thread and updates of the job from
+  // different threads. held while a dialog is shown, so keep it short otherwise.
+  QMutex lock_;
+
+  // hold the conflicts instead of asking the user right away
+  bool deferConflicts_;
+  QList<Conflict> conflicts_;
+
+  // progress of deleting. we don't know the total number of files in advance,
+  // so it's estimated from the number of files found in the dirs read so far.
+  bool deleting_;
+  goffset foundFiles_;
+  goffset removedFiles_;
+  goffset readDirs_;
+  goffset unreadDirs_;
+};
+
+// copy a small file in a worker thread
+class NativeFileOps::CopyTask : public QRunnable {
+public:
+  CopyTask(NativeFileOps* ops, const QByteArray& src, const struct stat& st, const QByteArray& dest, bool move, DirNode* parent):
+    ops_(ops),
+    src_(src),
+    st_(st),
+    dest_(dest),
+    move_(move),
+    parent_(parent) {
+  }
+
+  virtual void run() {
+    Result result = Failed;
+    if(!ops_->isCancelled()) {
+      result = ops_->copyRegularFile(src_, st_, dest_);
+      if(result == Done)
+        ops_->journalFile(src_, st_);
+      if(move_ && result == Done && unlink(src_.constData()) != 0) {
+        ops_->reportError(src_, errno);
+        result = Failed;
+      }
+    }
+    ops_->finishChild(parent_, result);
+    ops_->queueSlots_.release();
+  }
+
+private:
+  NativeFileOps* ops_;
+  QByteArray src_;
+  struct stat st_;
+  QByteArray dest_;
+  bool move_;
+  DirNode* parent_;
+};
+
+// delete the content of a dir in a worker thread
+class NativeFileOps::DeleteTask : public QRunnable {
+public:
+  DeleteTask(NativeFileOps* ops, DirNode* node):
+    ops_(ops),
+    node_(node) {
+  }
+
+  virtual void run() {
+    ops_->deleteDir(node_);
+    ops_->queueSlots_.release();
+  }
+
+private:
+  NativeFileOps* ops_;
+  DirNode* node_;
+};
+
+NativeFileOps::NativeFileOps(FmFileOpsJob* job):
+  job_(job),
+  journal_(FM_NATIVE_FILE_OPS_JOB(job)->journal),
+  destDev_(0),
+  lastCurFileTime_(0),
+  pool_(new QThreadPool()),
+  queueSlots_(MAX_QUEUED_FILES),
+  dirFdSlots_(MAX_OPEN_DIRS),
+  deferConflicts_(true),
+  deleting_(false),
+  foundFiles_(0),
+  removedFiles_(0),
+  readDirs_(0),
+  unreadDirs_(0) {
+  pool_->setMaxThreadCount(MAX_WORKER_THREADS);
+}
+
+NativeFileOps::~NativeFileOps() {
+  delete pool_;
+}
+
+// static
+bool NativeFileOps::canHandle(FmFileOpsJob* job) {
+  switch(job->type) {
+  case FM_FILE_OP_COPY:
+  case FM_FILE_OP_MOVE:
+    if(!job->dest || !fm_path_is_native(job->dest))
+      return false;
+    break;
+  case FM_FILE_OP_DELETE:
+  case FM_FILE_OP_TRASH:
+    break;
+  default:
+    return false;
+  }
+  // files in other file systems go to the trash cans of their own,
+  // which are handled by FmFileOpsJob.
+  bool trash = (job->type == FM_FILE_OP_TRASH);
+  struct stat dataSt;
+  if(trash && stat(g_get_user_data_dir(), &dataSt) != 0)
+    return false;
+  for(GList* l = fm_path_list_peek_head_link(job->srcs); l; l = l->next) {
+    FmPath* path = FM_PATH(l->data);
+    if(!fm_path_is_native(path))
+      return false;
+    if(trash) {
+      char* str = fm_path_to_str(path);
+      struct stat st;
+      bool sameFs = (lstat(str, &st) == 0 && st.st_dev == dataSt.st_dev);
+      g_free(str);
+      if(!sameFs)
+        return false;
+    }
+  }
+  return true;
+}
+
+bool NativeFileOps::run() {
+  if(job_->type == FM_FILE_OP_DELETE)
+    return runDelete();
+  if(job_->type == FM_FILE_OP_TRASH)
+    return runTrash();
+  return runTransfer();
+}
+
+bool NativeFileOps::runTransfer() {
+  char* destDir = fm_path_to_str(job_->dest);
+  QByteArray destDirPath(destDir);
+  g_free(destDir);
+  struct stat destSt;
+  if(stat(destDirPath.constData(), &destSt) != 0) {
+    reportError(destDirPath, errno);
+    return false;
+  }
+  destDev_ = destSt.st_dev;
+  bool move = (job_->type == FM_FILE_OP_MOVE);
+
+  // count the total size for progress reporting
+  QList<Source> sources;
+  job_->total = 0;
+  job_->finished = 0;
+  for(GList* l = fm_path_list_peek_head_link(job_->srcs); l && !isCancelled(); l = l->next) {
+    char* path = fm_path_to_str(FM_PATH(l->data));
+    Source src;
+    src.path = path;
+    g_free(path);
+    if(lstat(src.path.constData(), &src.st) != 0) {
+      reportError(src.path, errno);
+      continue;
+    }
+    // moving inside the same file system is only renaming, no need to count the content.
+    if(move && src.st.st_dev == destDev_)
+      job_->total += src.st.st_size;
+    else
+      job_->total += countTree(src.path, src.st);
+    sources.append(src);
+  }
+  fm_file_ops_job_emit_prepared(job_);
+
+  Q_FOREACH(const Source& src, sources) {
+    if(isCancelled())
+      break;
+    if(S_ISDIR(src.st.st_mode) && (destDirPath == src.path || destDirPath.startsWith(src.path + '/'))) {
+      GError* err = g_error_new(G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                                "%s: %s", src.path.constData(),
+                                move ? "Cannot move a folder into its sub folder" : "Cannot copy a folder into its sub folder");
+      emitError(err);
+      g_error_free(err);
+      continue;
+    }
+    const char* name = strrchr(src.path.constData(), '/');
+    name = name ? name + 1 : src.path.constData();
+    transferItem(src.path, src.st, childPath(destDirPath, name), move, NULL);
+  }
+  // wait for the queued small files
+  pool_->waitForDone();
+  // everything else is done. now ask the user about the held files.
+  if(!conflicts_.isEmpty()) {
+    resolveConflicts();
+    pool_->waitForDone();
+  }
+  return !isCancelled();
+}
+
+goffset NativeFileOps::countTree(const QByteArray& path, const struct stat& st) {
+  goffset size = st.st_size;
+  if(S_ISDIR(st.st_mode)) {
+    DIR* dir = opendir(path.constData());
+    if(dir) {
+      struct dirent* ent;
+      while(!isCancelled() && (ent = readdir(dir))) {
+        if(strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+          continue;
+        struct stat childSt;
+        if(fstatat(dirfd(dir), ent->d_name, &childSt, AT_SYMLINK_NOFOLLOW) == 0)
+          size += countTree(childPath(path, ent->d_name), childSt);
+      }
+      closedir(dir);
+    }
+  }
+  return size;
+}
+
+// copy or move src to destPath, asking the user what to do if destPath exists.
+NativeFileOps::Result NativeFileOps::transferItem(const QByteArray& src, const struct stat& st, const QByteArray& destPath, bool move, DirNode* parent) {
+  QByteArray dest = destPath;
+  bool merge = false;
+  struct stat destSt;
+  setCurFile(src);
+  while(lstat(dest.constData(), &destSt) == 0) { // the destination exists
+    if(isFinishedBefore(src, st, destSt)) {
+      if(move && unlink(src.constData()) != 0) {
+        reportError(src, errno);
+        return Failed;
+      }
+      addFinished(st.st_size);
+      return Done;
+    }
+    if(isLeftBehind(dest, destSt)) { // replace the incomplete copy
+      if(!prepareOverwrite(src, st, dest, destSt, merge))
+        return Failed;
+      break;
+    }
+    if(deferConflicts_) {
+      // dirs are merged right away, and only the conflicts of their content are held.
+      if(S_ISDIR(st.st_mode) && S_ISDIR(destSt.st_mode)
+         && (destSt.st_dev != st.st_dev || destSt.st_ino != st.st_ino)) {
+        merge = true;
+        break;
+      }
+      holdConflict(src, st, dest, destSt, move, parent);
+      return Pending;
+    }
+    QByteArray newDest;
+    FmFileOpOption option = askRename(src, dest, newDest);
+    if(option == FM_FILE_OP_RENAME && !newDest.isEmpty()) {
+      dest = newDest;
+      continue; // check the new name again
+    }
+    if(option == FM_FILE_OP_OVERWRITE) {
+      if(!prepareOverwrite(src, st, dest, destSt, merge))
+        return Failed;
+      break;
+    }
+    if(option == FM_FILE_OP_SKIP || option == FM_FILE_OP_SKIP_ERROR)
+      return skipItem(src, st, move);
+    fm_job_cancel(FM_JOB(job_));
+    return Failed;
+  }
+  return transferTo(src, st, dest, merge, move, parent);
+}
+
+// copy or move src to dest after the conflict, if any, is resolved
+NativeFileOps::Result NativeFileOps::transferTo(const QByteArray& src, const struct stat& st, const QByteArray& dest, bool merge, bool move, DirNode* parent) {
+  // moving in the same file system. only renaming is needed.
+  if(move && !merge && st.st_dev == destDev_) {
+    if(rename(src.constData(), dest.constData()) == 0) {
+      addFinished(st.st_size);
+      return Done;
+    }
+    if(errno != EXDEV) { // EXDEV happens with bind mounts. copy the files instead.
+      reportError(src, errno);
+      return Failed;
+    }
+  }
+
+  if(S_ISDIR(st.st_mode))
+    return copyDir(src, st, dest, merge, move, parent);
+
+  if(S_ISREG(st.st_mode) && st.st_size < SMALL_FILE_SIZE) {
+    // let the worker threads copy it
+    if(parent)
+      parent->pending.ref();
+    queueSlots_.acquire();
+    pool_->start(new CopyTask(this, src, st, dest, move, parent));
+    return Pending;
+  }
+
+  Result result = copyFile(src, st, dest);
+  if(result == Done)
+    journalFile(src, st);
+  // remove the source after its content is moved to the destination
+  if(move && result == Done && unlink(src.constData()) != 0) {
+    reportError(src, errno);
+    result = Failed;
+  }
+  return result;
+}
+
+// make room for src at dest, or merge the dirs
+bool NativeFileOps::prepareOverwrite(const QByteArray& src, const struct stat& st, const QByteArray& dest, const struct stat& destSt, bool& merge) {
+  if(destSt.st_dev == st.st_dev && destSt.st_ino == st.st_ino) {
+    reportError(src, EEXIST); // src and dest are the same file
+    return false;
+  }
+  if(S_ISDIR(st.st_mode) && S_ISDIR(destSt.st_mode))
+    merge = true; // copy the content into the existing dir
+  else if(S_ISDIR(st.st_mode) || S_ISDIR(destSt.st_mode)) {
+    // never replace a dir with a file or the reverse, like GIO does.
+    // deleting the existing tree would lose data the user didn't choose to lose.
+    reportError(dest, S_ISDIR(destSt.st_mode) ? EISDIR : ENOTDIR);
+    return false;
+  }
+  else if(unlink(dest.constData()) != 0) {
+    reportError(dest, errno);
+    return false;
+  }
+  return true;
+}
+
+NativeFileOps::Result NativeFileOps::skipItem(const QByteArray& src, const struct stat& st, bool move) {
+  addFinished(move && st.st_dev == destDev_ ? st.st_size : countTree(src, st));
+  return Skipped;
+}
+
+// the parent dir is not finished until the held file is resolved
+void NativeFileOps::holdConflict(const QByteArray& src, const struct stat& st, const QByteArray& dest, const struct stat& destSt, bool move, DirNode* parent) {
+  Conflict conflict;
+  conflict.src = src;
+  conflict.st = st;
+  conflict.dest = dest;
+  conflict.destSt = destSt;
+  conflict.move = move;
+  conflict.parent = parent;
+  if(parent)
+    parent->pending.ref();
+  conflicts_.append(conflict);
+}
+
+// let the user decide what to do with all of the held files at once
+void NativeFileOps::resolveConflicts() {
+  deferConflicts_ = false; // conflicts found from now on are asked one by one
+  QList<FileConflict> answers;
+  answers.reserve(conflicts_.size());
+  Q_FOREACH(const Conflict& conflict, conflicts_) {
+    FileConflict answer;
+    const char* name = strrchr(conflict.dest.constData(), '/');
+    char* str = g_filename_display_basename(name ? name + 1 : conflict.dest.constData());
+    answer.name = QString::fromUtf8(str);
+    g_free(str);
+    str = g_filename_display_name(conflict.src.constData());
+    answer.srcPath = QString::fromUtf8(str);
+    g_free(str);
+    str = g_filename_display_name(conflict.dest.constData());
+    answer.destPath = QString::fromUtf8(str);
+    g_free(str);
+    answer.srcSize = conflict.st.st_size;
+    answer.destSize = conflict.destSt.st_size;
+    answer.srcMtime = conflict.st.st_mtime;
+    answer.destMtime = conflict.destSt.st_mtime;
+    answer.srcMode = conflict.st.st_mode;
+    answer.destMode = conflict.destSt.st_mode;
+    answer.action = FM_FILE_OP_CANCEL;
+    answers.append(answer);
+  }
+  {
+    QMutexLocker locker(&lock_);
+    fm_job_call_main_thread(FM_JOB(job_), emitResolveConflicts, &answers);
+  }
+
+  for(int i = 0; i < conflicts_.size(); ++i) {
+    const Conflict& conflict = conflicts_.at(i);
+    Result result = Failed;
+    if(!isCancelled()) {
+      setCurFile(conflict.src);
+      result = resolveConflict(conflict, answers.at(i).action, answers.at(i).newName);
+    }
+    // release the hold of the conflict on the parent dir
+    finishChild(conflict.parent, (result == Skipped || result == Failed) ? Failed : Done);
+  }
+  conflicts_.clear();
+}
+
+NativeFileOps::Result NativeFileOps::resolveConflict(const Conflict& conflict, FmFileOpOption action, const QString& newName) {
+  struct stat destSt;
+  switch(action) {
+  case FM_FILE_OP_OVERWRITE:
+    if(lstat(conflict.dest.constData(), &destSt) == 0) { // it may be gone by now
+      bool merge = false;
+      if(!prepareOverwrite(conflict.src, conflict.st, conflict.dest, destSt, merge))
+        return Failed;
+      return transferTo(conflict.src, conflict.st, conflict.dest, merge, conflict.move, conflict.parent);
+    }
+    break;
+  case FM_FILE_OP_RENAME: {
+    QByteArray dest;
+    if(newName.isEmpty())
+      dest = freeName(conflict.dest);
+    else {
+      int sep = conflict.dest.lastIndexOf('/');
+      dest = conflict.dest.left(sep + 1) + QFile::encodeName(newName);
+    }
+    return transferItem(conflict.src, conflict.st, dest, conflict.move, conflict.parent);
+  }
+  case FM_FILE_OP_SKIP:
+  case FM_FILE_OP_SKIP_ERROR:
+    return skipItem(conflict.src, conflict.st, conflict.move);
+  default: // not answered
+    break;
+  }
+  // ask the user about this file alone
+  return transferItem(conflict.src, conflict.st, conflict.dest, conflict.move, conflict.parent);
+}
+
+// resuming an interrupted operation, and the file was finished before.
+// the copy is checked since it might be changed after the interruption.
+bool NativeFileOps::isFinishedBefore(const QByteArray& src, const struct stat& st, const struct stat& destSt) {
+  return journal_ && journal_->isResumed() && !S_ISDIR(st.st_mode)
+         && journal_->isFinished(src, st)
+         && destSt.st_size == st.st_size && destSt.st_mtime == st.st_mtime;
+}
+
+// resuming an interrupted operation, and the file was created by it but not finished.
+// only the files recorded in the journal count. anything else existing there,
+// even if it's changed after the operation started, is a normal conflict.
+bool NativeFileOps::isLeftBehind(const QByteArray& dest, const struct stat& destSt) {
+  return journal_ && journal_->isResumed() && !S_ISDIR(destSt.st_mode)
+         && journal_->isCreated(dest);
+}
+
+// find a name which is not used yet, like "file (2).txt"
+QByteArray NativeFileOps::freeName(const QByteArray& path) {
+  int sep = path.lastIndexOf('/');
+  int dot = path.lastIndexOf('.');
+  if(dot <= sep + 1) // no suffix, or a hidden file
+    dot = path.size();
+  QByteArray base = path.left(dot);
+  QByteArray suffix = path.mid(dot);
+  struct stat st;
+  for(int n = 2; ; ++n) {
+    QByteArray name = base + " (" + QByteArray::number(n) + ')' + suffix;
+    if(lstat(name.constData(), &st) != 0 && errno == ENOENT)
+      return name;
+  }
+}
+
+NativeFileOps::Result NativeFileOps::copyDir(const QByteArray& src, const struct stat& st, const QByteArray& dest, bool merge, bool move, DirNode* parent) {
+  if(!merge) {
+    // make sure we can write into the new dir. the real mode is restored later.
+    while(mkdir(dest.constData(), (st.st_mode & 07777) | S_IRWXU) != 0) {
+      if(!reportError(dest, errno))
+        return Failed;
+    }
+  }
+  addFinished(st.st_size);
+
+  DIR* dir = opendir(src.constData());
+  if(!dir) {
+    reportError(src, errno);
+    return Failed;
+  }
+  DirNode* node = new DirNode();
+  node->src = src;
+  node->dest = dest;
+  node->st = st;
+  node->merge = merge;
+  node->move = move;
+  node->parent = parent;
+  node->fd = -1;
+  node->fdSlot = false;
+  node->pending = 1; // held until all children are queued
+  node->failed = 0;
+  if(parent)
+    parent->pending.ref();
+
+  struct dirent* ent;
+  while(!isCancelled() && (ent = readdir(dir))) {
+    if(strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+      continue;
+    QByteArray childSrc = childPath(src, ent->d_name);
+    struct stat childSt;
+    Result childResult;
+    if(fstatat(dirfd(dir), ent->d_name, &childSt, AT_SYMLINK_NOFOLLOW) == 0)
+      childResult = transferItem(childSrc, childSt, childPath(dest, ent->d_name), move, node);
+    else {
+      reportError(childSrc, errno);
+      childResult = Failed;
+    }
+    if(childResult == Skipped || childResult == Failed)
+      node->failed.fetchAndStoreOrdered(1);
+  }
+  closedir(dir);
+  finishChild(node, isCancelled() ? Failed : Done); // release the hold of the walker
+  return Pending;
+}
+
+// a child of the dir node is finished. finish the dir, too, if it's the last one.
+void NativeFileOps::finishChild(DirNode* node, Result result) {
+  while(node) {
+    if(result != Done)
+      node->failed.fetchAndStoreOrdered(1);
+    if(node->pending.deref())
+      break;
+    // all children are done
+    DirNode* parent = node->parent;
+    result = finishDir(node);
+    delete node;
+    node = parent;
+  }
+}
+
+NativeFileOps::Result NativeFileOps::finishDir(DirNode* node) {
+  Result result = node->failed.fetchAndAddOrdered(0) ? Failed : Done;
+  if(deleting_) { // the dir is empty now
+    if(result == Done) {
+      int ret = node->parent ? unlinkat(node->parent->fd, node->name.constData(), AT_REMOVEDIR)
+                             : rmdir(node->src.constData());
+      if(ret == 0) {
+        QMutexLocker locker(&lock_);
+        ++removedFiles_;
+        updateDeleteProgress();
+      }
+      else {
+        reportError(node->src, errno);
+        result = Failed;
+      }
+    }
+    if(node->fd >= 0)
+      close(node->fd);
+    if(node->fdSlot)
+      dirFdSlots_.release();
+    return result;
+  }
+
+  // restore the mode and times after the content is written
+  if(!node->merge) {
+    chmod(node->dest.constData(), node->st.st_mode & 07777);
+    setTimes(node->dest, node->st);
+  }
+  // remove the source after its content is moved to the destination
+  if(node->move && result == Done && rmdir(node->src.constData()) != 0) {
+    reportError(node->src, errno);
+    result = Failed;
+  }
+  return result;
+}
+
+// delete files without counting them first. the dirs are removed in parallel.
+bool NativeFileOps::runDelete() {
+  deleting_ = true;
+  job_->total = 0;
+  job_->finished = 0;
+  fm_file_ops_job_emit_prepared(job_);
+
+  for(GList* l = fm_path_list_peek_head_link(job_->srcs); l && !isCancelled(); l = l->next) {
+    char* str = fm_path_to_str(FM_PATH(l->data));
+    QByteArray path(str);
+    g_free(str);
+    {
+      QMutexLocker locker(&lock_);
+      ++foundFiles_;
+    }
+    struct stat st;
+    if(lstat(path.constData(), &st) != 0) {
+      reportError(path, errno);
+      continue;
+    }
+    if(S_ISDIR(st.st_mode)) {
+      {
+        QMutexLocker locker(&lock_);
+        ++unreadDirs_;
+      }
+      DirNode* node = newDeleteNode(path, NULL, NULL);
+      node->fdSlot = dirFdSlots_.tryAcquire();
+      deleteDir(node);
+    }
+    else if(unlink(path.constData()) == 0) {
+      QMutexLocker locker(&lock_);
+      ++removedFiles_;
+      updateDeleteProgress();
+    }
+    else
+      reportError(path, errno);
+  }
+  pool_->waitForDone();
+  return !isCancelled();
+}
+
+NativeFileOps::DirNode* NativeFileOps::newDeleteNode(const QByteArray& path, const char* name, DirNode* parent) {
+  DirNode* node = new DirNode();
+  node->src = path;
+  node->merge = false;
+  node->move = false;
+  node->parent = parent;
+  if(name)
+    node->name = name;
+  node->fd = -1;
+  node->fdSlot = false;
+  node->pending = 1; // held until all children are removed or queued
+  node->failed = 0;
+  if(parent)
+    parent->pending.ref();
+  return node;
+}
+
+// remove the files in the dir, and queue its sub dirs for the workers
+void NativeFileOps::deleteDir(DirNode* node) {
+  setCurFile(node->src);
+  // a sub dir is opened relative to its parent rather than by its path. O_NOFOLLOW
+  // only checks the last component, so if a dir in the path is replaced with a
+  // symlink while we're working, opening by path could delete outside the tree.
+  if(node->parent)
+    node->fd = openat(node->parent->fd, node->name.constData(), O_RDONLY|O_DIRECTORY|O_NOFOLLOW);
+  else
+    node->fd = open(node->src.constData(), O_RDONLY|O_DIRECTORY|O_NOFOLLOW);
+  int fd = node->fd;
+  // node->fd is still needed by the sub dirs after the DIR is closed
+  int dirFd = fd >= 0 ? dup(fd) : -1;
+  DIR* dir = dirFd >= 0 ? fdopendir(dirFd) : NULL;
+  if(!dir) {
+    int errnum = errno;
+    if(dirFd >= 0)
+      close(dirFd);
+    reportError(node->src, errnum);
+    {
+      QMutexLocker locker(&lock_);
+      --unreadDirs_;
+    }
+    finishChild(node, Failed);
+    return;
+  }
+
+  int found = 0;
+  int removed = 0;
+  QList<DirNode*> subDirs;
+  struct dirent* ent;
+  while(!isCancelled() && (ent = readdir(dir))) {
+    if(strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+      continue;
+    ++found;
+    bool isDir = (ent->d_type == DT_DIR);
+    if(ent->d_type == DT_UNKNOWN) { // some file systems don't fill d_type
+      struct stat st;
+      isDir = (fstatat(fd, ent->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode));
+    }
+    if(isDir)
+      subDirs.append(newDeleteNode(childPath(node->src, ent->d_name), ent->d_name, node));
+    else if(unlinkat(fd, ent->d_name, 0) == 0)
+      ++removed;
+    else {
+      reportError(childPath(node->src, ent->d_name), errno);
+      node->failed.fetchAndStoreOrdered(1);
+    }
+  }
+  closedir(dir);
+
+  {
+    QMutexLocker locker(&lock_);
+    foundFiles_ += found;
+    removedFiles_ += removed;
+    ++readDirs_;
+    unreadDirs_ += subDirs.size() - 1;
+    updateDeleteProgress();
+  }
+
+  // the DIR is closed before going into the sub dirs, so only the fd of each
+  // unfinished dir is kept open. a queued sub dir takes a slot for its fd.
+  // if the queue or the slots are full, the sub dir is deleted in this thread
+  // instead, depth first. such a dir has no slot and never queues its own sub
+  // dirs, so it's finished and closed when deleteDir() returns. this way, at
+  // most MAX_OPEN_DIRS dirs plus one chain of dirs per thread are open.
+  Q_FOREACH(DirNode* subDir, subDirs) {
+    if(node->fdSlot && dirFdSlots_.tryAcquire()) {
+      if(queueSlots_.tryAcquire()) {
+        subDir->fdSlot = true;
+        pool_->start(new DeleteTask(this, subDir));
+        continue;
+      }
+      dirFdSlots_.release();
+    }
+    deleteDir(subDir);
+  }
+  finishChild(node, isCancelled() ? Failed : Done); // release the hold of the walker
+}
+
+// estimate the total number of files with the average number of
+// files in the dirs read so far. must be called with lock_ held.
+void NativeFileOps::updateDeleteProgress() {
+  goffset average = readDirs_ > 0 ? foundFiles_ / readDirs_ : 1;
+  job_->total = foundFiles_ + unreadDirs_ * average;
+  job_->finished = qMin(removedFiles_, job_->total);
+  fm_file_ops_job_emit_percent(job_); // only emitted when the percentage increases
+}
+
+// move the files to the trash can in the home dir, as the trash spec of
+// freedesktop.org says. the trash info file is created first to reserve the
+// name, and then the file is renamed into the trash can.
+bool NativeFileOps::runTrash() {
+  QByteArray trashDir = QByteArray(g_get_user_data_dir()) + "/Trash";
+  if(g_mkdir_with_parents((trashDir + "/files").constData(), 0700) != 0
+     || g_mkdir_with_parents((trashDir + "/info").constData(), 0700) != 0) {
+    reportError(trashDir, errno);
+    return false;
+  }
+  job_->total = fm_path_list_get_length(job_->srcs);
+  job_->finished = 0;
+  fm_file_ops_job_emit_prepared(job_);
+
+  QHash<QByteArray, int> nextSuffix; // avoid trying the same names again and again
+  QList<TrashItem> batch;
+  GList* l = fm_path_list_peek_head_link(job_->srcs);
+  while(l && !isCancelled()) {
+    char date[32];
+    time_t now = time(NULL);
+    struct tm tm;
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime_r(&now, &tm));
+
+    // write the info files of a batch of files
+    int count = 0;
+    batch.clear();
+    for(; l && count < TRASH_BATCH_SIZE && !isCancelled(); l = l->next, ++count) {
+      char* str = fm_path_to_str(FM_PATH(l->data));
+      QByteArray src(str);
+      g_free(str);
+      TrashItem item;
+      if(reserveTrashName(src, trashDir, date, nextSuffix, item))
+        batch.append(item);
+      else if(errno == ENAMETOOLONG) // GIO shortens the name for us
+        trashWithGio(src);
+      else
+        reportError(src, errno);
+    }
+
+    // then move them into the trash can
+    Q_FOREACH(const TrashItem& item, batch) {
+      if(isCancelled())
+        break;
+      setCurFile(item.src);
+      if(rename(item.src.constData(), item.dest.constData()) != 0) {
+        int errnum = errno;
+        unlink(item.info.constData());
+        if(errnum == EXDEV) // in a different file system after all. bind mounts can do this.
+          trashWithGio(item.src);
+        else
+          reportError(item.src, errnum);
+      }
+    }
+    addFinished(count);
+  }
+  if(isCancelled()) {
+    // remove the info files reserved for the files which are not moved
+    Q_FOREACH(const TrashItem& item, batch) {
+      if(g_file_test(item.src.constData(), G_FILE_TEST_EXISTS))
+        unlink(item.info.constData());
+    }
+    return false;
+  }
+  return true;
+}
+
+// find a free name in the trash can, and write the trash info file for it.
+// errno is set on failure.
+bool NativeFileOps::reserveTrashName(const QByteArray& src, const QByteArray& trashDir, const char* date, QHash<QByteArray, int>& nextSuffix, TrashItem& item) {
+  const char* name = strrchr(src.constData(), '/');
+  QByteArray baseName(name ? name + 1 : src.constData());
+  char* escapedPath = g_uri_escape_string(src.constData(), "/", FALSE);
+  QByteArray content = "[Trash Info]\nPath=" + QByteArray(escapedPath) + "\nDeletionDate=" + date + "\n";
+  g_free(escapedPath);
+
+  for(int n = nextSuffix.value(baseName, 1); ; ++n) {
+    QByteArray trashName = (n == 1) ? baseName : baseName + '.' + QByteArray::number(n);
+    item.info = trashDir + "/info/" + trashName + ".trashinfo";
+    int fd = open(item.info.constData(), O_WRONLY|O_CREAT|O_EXCL, 0600);
+    if(fd < 0) {
+      if(errno == EEXIST)
+        continue;
+      return false;
+    }
+    item.dest = trashDir + "/files/" + trashName;
+    struct stat st;
+    if(lstat(item.dest.constData(), &st) == 0) { // a file without the info file. don't replace it.
+      close(fd);
+      unlink(item.info.constData());
+      continue;
+    }
+    bool ok = (write(fd, content.constData(), content.size()) == content.size());
+    int errnum = errno;
+    if(close(fd) != 0 && ok) {
+      errnum = errno;
+      ok = false;
+    }
+    if(!ok) {
+      unlink(item.info.constData());
+      errno = errnum;
+      return false;
+    }
+    nextSuffix.insert(baseName, n + 1);
+    item.src = src;
+    return true;
+  }
+}
+
+void NativeFileOps::trashWithGio(const QByteArray& src) {
+  GFile* gf = g_file_new_for_path(src.constData());
+  GError* err = NULL;
+  if(!g_file_trash(gf, fm_job_get_cancellable(FM_JOB(job_)), &err)) {
+    emitError(err);
+    g_error_free(err);
+  }
+  g_object_unref(gf);
+}
+
+// copy a file which is not a dir
+NativeFileOps::Result NativeFileOps::copyFile(const QByteArray& src, const struct stat& st, const QByteArray& dest) {
+  if(S_ISREG(st.st_mode))
+    return copyRegularFile(src, st, dest);
+
+  int ret;
+  if(S_ISLNK(st.st_mode)) {
+    QByteArray target(st.st_size > 0 ? st.st_size + 1 : PATH_MAX, '\0');
+    ssize_t len = readlink(src.constData(), target.data(), target.size());
+    if(len < 0) {
+      reportError(src, errno);
+      return Failed;
+    }
+    target.truncate(len);
+    ret = symlink(target.constData(), dest.constData());
+  }
+  else // fifos, sockets, and devices
+    ret = mknod(dest.constData(), st.st_mode, st.st_rdev);
+
+  if(ret != 0) {
+    reportError(dest, errno);
+    return Failed;
+  }
+  journalCreated(dest);
+  setTimes(dest, st);
+  addFinished(st.st_size);
+  return Done;
+}
+
+NativeFileOps::Result NativeFileOps::copyRegularFile(const QByteArray& src, const struct stat& st, const QByteArray& dest) {
+  for(;;) { // retry loop
+    int srcFd = open(src.constData(), O_RDONLY);
+    if(srcFd < 0) {
+      if(reportError(src, errno))
+        continue;
+      return Failed;
+    }
+    int destFd = open(dest.constData(), O_WRONLY|O_CREAT|O_EXCL, 0600);
+    if(destFd < 0) {
+      int errnum = errno;
+      close(srcFd);
+      if(reportError(dest, errnum))
+        continue;
+      return Failed;
+    }
+    journalCreated(dest);
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(srcFd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    goffset copied = 0;
+    bool ok = copyData(srcFd, destFd, st.st_size, copied);
+    int errnum = errno;
+    if(ok) {
+      copyMetadata(srcFd, destFd, st);
+      if(close(destFd) != 0) { // delayed write errors of NFS are reported here
+        errnum = errno;
+        ok = false;
+      }
+    }
+    else
+      close(destFd);
+#ifdef POSIX_FADV_DONTNEED
+    // don't let copying large files push everything else out of the page cache
+    posix_fadvise(srcFd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+    close(srcFd);
+    if(ok)
+      return Done;
+
+    unlink(dest.constData()); // remove the incomplete file
+    addFinished(-copied);
+    if(isCancelled() || !reportError(src, errnum))
+      return Failed;
+  }
+}
+
+// copy the content of srcFd to destFd with the fastest method available.
+// a reflink shares the data blocks on btrfs and XFS, copy_file_range() copies
+// inside the kernel (or on the server for NFS), sendfile() avoids copying the
+// data to userspace, and read()/write() with a large buffer works everywhere.
+// copied is set to the number of bytes added to the progress.
+bool NativeFileOps::copyData(int srcFd, int destFd, goffset size, goffset& copied) {
+#ifdef FICLONE
+  if(ioctl(destFd, FICLONE, srcFd) == 0) {
+    copied = size;
+    addFinished(size);
+    return true;
+  }
+#endif
+
+#ifdef __linux__
+#ifdef SYS_copy_file_range
+  for(;;) {
+    if(isCancelled()) {
+      errno = ECANCELED;
+      return false;
+    }
+    ssize_t n = syscall(SYS_copy_file_range, srcFd, NULL, destFd, NULL, (size_t)COPY_CHUNK_SIZE, 0);
+    if(n > 0) {
+      copied += n;
+      addFinished(n);
+    }
+    else if(n == 0) {
+      if(copied > 0)
+        return true;
+      // pseudo files like the ones in /proc have st_size 0 and can only be read().
+      // an empty file is found empty again by read(), so nothing is lost.
+      break;
+    }
+    else if(errno == EINTR)
+      continue;
+    else if(copied == 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP))
+      break; // not supported for these files. try sendfile().
+    else
+      return false;
+  }
+#endif
+  for(;;) {
+    if(isCancelled()) {
+      errno = ECANCELED;
+      return false;
+    }
+    ssize_t n = sendfile(destFd, srcFd, NULL, COPY_CHUNK_SIZE);
+    if(n > 0) {
+      copied += n;
+      addFinished(n);
+    }
+    else if(n == 0) {
+      if(copied > 0)
+        return true;
+      break; // maybe a pseudo file. see above.
+    }
+    else if(errno == EINTR)
+      continue;
+    else if(copied == 0 && (errno == EINVAL || errno == ENOSYS))
+      break; // try read() and write()
+    else
+      return false;
+  }
+#endif
+
+  // called from different threads, so each call has its own buffer
+  size_t bufferSize = (size_t)qBound(goffset(4096), size + 1, goffset(COPY_BUFFER_SIZE));
+  char* buffer = (char*)g_malloc(bufferSize);
+  bool ok = true;
+  for(;;) {
+    if(isCancelled()) {
+      errno = ECANCELED;
+      ok = false;
+      break;
+    }
+    ssize_t n = read(srcFd, buffer, bufferSize);
+    if(n == 0)
+      break;
+    if(n < 0) {
+      if(errno == EINTR)
+        continue;
+      ok = false;
+      break;
+    }
+    for(ssize_t written = 0; ok && written < n;) {
+      ssize_t ret = write(destFd, buffer + written, n - written);
+      if(ret >= 0)
+        written += ret;
+      else if(errno != EINTR)
+        ok = false;
+    }
+    if(!ok)
+      break;
+    copied += n;
+    addFinished(n);
+  }
+  int errnum = errno;
+  g_free(buffer);
+  errno = errnum;
+  return ok;
+}
+
+// copy what GIO copies with G_FILE_COPY_ALL_METADATA: the owner where
+// allowed, extended attributes (including POSIX ACLs), the mode and the times.
+// like GIO, failing to copy any of them does not fail the copy.
+void NativeFileOps::copyMetadata(int srcFd, int destFd, const struct stat& st) {
+  // chown() clears the setuid and setgid bits, so it goes before chmod().
+  // normal users can only change the group to one of their own.
+  if(fchown(destFd, st.st_uid, st.st_gid) != 0 && fchown(destFd, (uid_t)-1, st.st_gid) != 0) {
+    // not allowed. the file keeps the default owner and group.
+  }
+
+#ifdef __linux__
+  ssize_t listSize = flistxattr(srcFd, NULL, 0);
+  if(listSize > 0) {
+    QByteArray names(listSize, '\0');
+    listSize = flistxattr(srcFd, names.data(), names.size());
+    QByteArray value;
+    for(ssize_t i = 0; i < listSize; i += strlen(names.constData() + i) + 1) {
+      const char* name = names.constData() + i;
+      ssize_t valueSize = fgetxattr(srcFd, name, NULL, 0);
+      if(valueSize < 0)
+        continue;
+      value.resize(valueSize);
+      valueSize = fgetxattr(srcFd, name, value.data(), value.size());
+      if(valueSize < 0)
+        continue;
+      // fails for trusted.* and security.* as a normal user, or if the
+      // destination fs does not support xattrs. that's fine.
+      fsetxattr(destFd, name, value.constData(), valueSize, 0);
+    }
+  }
+#endif
+
+  fchmod(destFd, st.st_mode & 07777);
+  struct timespec times[2] = {st.st_atim, st.st_mtim};
+  futimens(destFd, times);
+}
+
+void NativeFileOps::setTimes(const QByteArray& path, const struct stat& st) {
+  struct timespec times[2] = {st.st_atim, st.st_mtim};
+  utimensat(AT_FDCWD, path.constData(), times, AT_SYMLINK_NOFOLLOW);
+}
+
+FmFileOpOption NativeFileOps::askRename(const QByteArray& src, const QByteArray& dest, QByteArray& newDest) {
+  QMutexLocker locker(&lock_);
+  GFile* srcFile = g_file_new_for_path(src.constData());
+  GFile* destFile = g_file_new_for_path(dest.constData());
+  GFile* newDestFile = NULL;
+  FmFileOpOption option = fm_file_ops_job_ask_rename(job_, srcFile, NULL, destFile, &newDestFile);
+  if(newDestFile) {
+    char* path = g_file_get_path(newDestFile);
+    newDest = path;
+    g_free(path);
+    g_object_unref(newDestFile);
+  }
+  g_object_unref(srcFile);
+  g_object_unref(destFile);
+  return option;
+}
+
+// report the error to the user. returns true if the user wants to retry.
+bool NativeFileOps::reportError(const QByteArray& path, int errnum) {
+  if(errnum == ECANCELED)
+    return false;
+  QMutexLocker locker(&lock_);
+  char* dispName = g_filename_display_name(path.constData());
+  GError* err = g_error_new(G_IO_ERROR, g_io_error_from_errno(errnum), "%s: %s", dispName, g_strerror(errnum));
+  g_free(dispName);
+  FmJobErrorAction action = fm_job_emit_error(FM_JOB(job_), err, FM_JOB_ERROR_MODERATE);
+  g_error_free(err);
+  if(action == FM_JOB_ABORT)
+    fm_job_cancel(FM_JOB(job_));
+  return action == FM_JOB_RETRY;
+}
+
+void NativeFileOps::emitError(GError* err) {
+  QMutexLocker locker(&lock_);
+  if(fm_job_emit_error(FM_JOB(job_), err, FM_JOB_ERROR_MODERATE) == FM_JOB_ABORT)
+    fm_job_cancel(FM_JOB(job_));
+}
+
+void NativeFileOps::setCurFile(const QByteArray& path) {
+  // the signal is emitted in the main thread, which costs a round trip.
+  // so don't do it for every small file.
+  QMutexLocker locker(&lock_);
+  gint64 now = g_get_monotonic_time();
+  if(now - lastCurFileTime_ >= CUR_FILE_INTERVAL) {
+    lastCurFileTime_ = now;
+    char* dispName = g_filename_display_name(path.constData());
+    fm_file_ops_job_emit_cur_file(job_, dispName);
+    g_free(dispName);
+  }
+}
+
+void NativeFileOps::addFinished(goffset size) {
+  QMutexLocker locker(&lock_);
+  job_->finished = qMin(job_->finished + size, job_->total);
+  fm_file_ops_job_emit_percent(job_); // only emitted when the percentage changes
+}
+
+} // namespace Fm
+
+using namespace Fm;
+
+G_DEFINE_TYPE(FmNativeFileOpsJob, fm_native_file_ops_job, fm_file_ops_job_get_type())
+
+static gboolean fm_native_file_ops_job_run(FmJob* job);
+
+static void fm_native_file_ops_job_class_init(FmNativeFileOpsJobClass* klass) {
+  FmJobClass* job_class = FM_JOB_CLASS(klass);
+  job_class->run = fm_native_file_ops_job_run;
+
+  // the param is a QList<Fm::FileConflict>*
+  signals[RESOLVE_CONFLICTS] =
+    g_signal_new("resolve-conflicts",
+                 G_TYPE_FROM_CLASS(klass),
+                 G_SIGNAL_RUN_LAST,
+                 0, NULL, NULL,
+                 g_cclosure_marshal_VOID__POINTER,
+                 G_TYPE_NONE, 1, G_TYPE_POINTER);
+}
+
+static void fm_native_file_ops_job_init(FmNativeFileOpsJob* self) {
+  self->journal = NULL;
+}
+
+static gboolean fm_native_file_ops_job_run(FmJob* job) {
+  FmFileOpsJob* fileOpsJob = (FmFileOpsJob*)job;
+  if(NativeFileOps::canHandle(fileOpsJob)) {
+    NativeFileOps ops(fileOpsJob);
+    return ops.run();
+  }
+  // not supported. let the original FmFileOpsJob do it.
+  return FM_JOB_CLASS(fm_native_file_ops_job_parent_class)->run(job);
+}
+
+// the same as fm_file_ops_job_new(), but creates a FmNativeFileOpsJob
+FmFileOpsJob* fm_native_file_ops_job_new(FmFileOpType type, FmPathList* files) {
+  FmFileOpsJob* job = (FmFileOpsJob*)g_object_new(FM_TYPE_NATIVE_FILE_OPS_JOB, NULL);
+  job->srcs = fm_path_list_ref(files);
+  job->type = type;
+  return job;
+}
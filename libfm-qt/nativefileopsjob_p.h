@@ -0,0 +1,83 @@
+/*
+
+    Copyright (C) 2013  Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+
+#ifndef FM_NATIVEFILEOPSJOB_P_H
+#define FM_NATIVEFILEOPSJOB_P_H
+
+#include <libfm/fm.h>
+#include <QString>
+#include <QList>
+
+// FmNativeFileOpsJob is a FmFileOpsJob which handles local files with native
+// system calls rather than the userspace read/write loop of GIO.
+// Anything it cannot handle is passed to the original FmFileOpsJob.
+// Files which already exist in the destination don't stop copying. They are
+// held until everything else is done, and then passed to the handlers of
+// the "resolve-conflicts" signal all at once, in the main thread:
+//   void (*resolve_conflicts)(FmNativeFileOpsJob* job, QList<Fm::FileConflict>* conflicts, gpointer user_data);
+// Conflicts left unanswered by the handlers are asked one by one with "ask-rename".
+#define FM_TYPE_NATIVE_FILE_OPS_JOB             (fm_native_file_ops_job_get_type())
+#define FM_NATIVE_FILE_OPS_JOB(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj),\
+FM_TYPE_NATIVE_FILE_OPS_JOB, FmNativeFileOpsJob))
+#define FM_IS_NATIVE_FILE_OPS_JOB(obj)          (G_TYPE_CHECK_INSTANCE_TYPE((obj),\
+FM_TYPE_NATIVE_FILE_OPS_JOB))
+
+namespace Fm {
+class FileOperationJournal;
+}
+
+typedef struct _FmNativeFileOpsJob          FmNativeFileOpsJob;
+typedef struct _FmNativeFileOpsJobClass     FmNativeFileOpsJobClass;
+
+struct _FmNativeFileOpsJob {
+  FmFileOpsJob parent;
+  Fm::FileOperationJournal* journal; // finished files are recorded here if it's set
+};
+
+struct _FmNativeFileOpsJobClass {
+  FmFileOpsJobClass parent_class;
+};
+
+GType           fm_native_file_ops_job_get_type(void);
+FmFileOpsJob*   fm_native_file_ops_job_new(FmFileOpType type, FmPathList* files);
+
+namespace Fm {
+
+// a file which already exists in the destination
+struct FileConflict {
+  QString name; // display name of the file
+  QString srcPath; // display names of the paths
+  QString destPath;
+  qint64 srcSize;
+  qint64 destSize;
+  qint64 srcMtime;
+  qint64 destMtime;
+  quint32 srcMode; // st_mode of the files, for their types
+  quint32 destMode;
+  // set by the handler: FM_FILE_OP_OVERWRITE, FM_FILE_OP_RENAME, or FM_FILE_OP_SKIP.
+  // FM_FILE_OP_CANCEL means no answer.
+  FmFileOpOption action;
+  QString newName; // used by FM_FILE_OP_RENAME. if it's empty, a free name is picked.
+};
+
+}
+
+#endif // FM_NATIVEFILEOPSJOB_P_H
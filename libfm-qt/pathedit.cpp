@@ -19,14 +19,237 @@
 
 
 #include "pathedit.h"
+#include "pathedit_p.h"
 #include <QCompleter>
 #include <QStringListModel>
 #include <QStringBuilder>
+#include <QHash>
+#include <QList>
 #include <QDebug>
+#include <algorithm>
 #include <libfm/fm.h>
+#include "cachedfoldermodel.h"
 
 namespace Fm {
 
+// max number of directory listings kept in the completion cache
+#define DIR_CACHE_SIZE  16
+
+// max number of items shown in the completion popup
+#define MAX_COMPLETIONS 64
+
+// scores of the matches. prefix matches always rank above fuzzy ones.
+#define PREFIX_MATCH_SCORE  100000
+#define CASE_MATCH_BONUS    1000
+
+PathCompletionIndex::PathCompletionIndex(const QStringList& names) {
+  entries_.reserve(names.size());
+  Q_FOREACH(const QString& name, names) {
+    Entry entry;
+    entry.name = name;
+    entry.folded = name.toLower();
+    entry.charMask = charMask(entry.folded);
+    entries_.append(entry);
+  }
+  // sort by folded names so prefix matches can be found with binary search
+  std::sort(entries_.begin(), entries_.end(), entryLessThan);
+}
+
+// static
+bool PathCompletionIndex::entryLessThan(const Entry& a, const Entry& b) {
+  return a.folded < b.folded;
+}
+
+// static
+bool PathCompletionIndex::matchLessThan(const Match& a, const Match& b) {
+  // higher scores first, and keep the alphabetical order for equal scores
+  if(a.score != b.score)
+    return a.score > b.score;
+  return a.index < b.index;
+}
+
+// static
+// a bit mask of the chars in the string, used to quickly
+// skip names which cannot contain all chars of the pattern.
+quint64 PathCompletionIndex::charMask(const QString& str) {
+  quint64 mask = 0;
+  const QChar* p = str.constData();
+  const QChar* end = p + str.length();
+  for(; p < end; ++p) {
+    ushort c = p->unicode();
+    int bit;
+    if(c >= 'a' && c <= 'z')
+      bit = c - 'a';
+    else if(c >= '0' && c <= '9')
+      bit = 26 + (c - '0');
+    else // all other chars share the remaining bits
+      bit = 36 + (c % 28);
+    mask |= (Q_UINT64_C(1) << bit);
+  }
+  return mask;
+}
+
+// static
+// greedy subsequence matching. returns 0 if the entry does not match.
+// consecutive matches and matches at the beginning of words are preferred.
+int PathCompletionIndex::fuzzyScore(const Entry& entry, const QString& pattern) {
+  const QString& folded = entry.folded;
+  const QString& name = entry.name;
+  // lower casing may change the length of some names (e.g. U+0130 becomes two
+  // chars). the indices in folded are only valid in name if the lengths match.
+  bool sameLength = (name.length() == folded.length());
+  int score = 0;
+  int pos = 0;
+  int prev = -2;
+  for(int i = 0; i < pattern.length(); ++i) {
+    int found = folded.indexOf(pattern[i], pos);
+    if(found < 0)
+      return 0;
+    score += 10;
+    if(found == prev + 1)
+      score += 8;
+    else {
+      if(found == 0 || !folded[found - 1].isLetterOrNumber()
+         || (sameLength && name[found].isUpper() && name[found - 1].isLower()))
+        score += 6; // start of a word
+      score -= qMin(found - pos, 5); // gap
+    }
+    prev = found;
+    pos = found + 1;
+  }
+  score -= qMin(folded.length() / 4, 10); // prefer shorter names
+  return qMax(score, 1);
+}
+
+QStringList PathCompletionIndex::query(const QString& pattern, int maxCount) const {
+  QStringList result;
+  if(pattern.isEmpty()) { // everything matches. return the first names alphabetically.
+    for(int i = 0; i < entries_.size() && i < maxCount; ++i)
+      result.append(entries_[i].name);
+    return result;
+  }
+
+  Entry key;
+  key.folded = pattern.toLower();
+  QVector<Match> matches;
+  // names starting with the pattern are contiguous in the sorted array
+  const Entry* begin = entries_.constData();
+  const Entry* end = begin + entries_.size();
+  const Entry* first = std::lower_bound(begin, end, key, entryLessThan);
+  const Entry* last = first;
+  for(; last < end && last->folded.startsWith(key.folded); ++last) {
+    Match match;
+    match.index = last - begin;
+    match.score = PREFIX_MATCH_SCORE - qMin(last->name.length(), CASE_MATCH_BONUS - 1);
+    if(last->name.startsWith(pattern))
+      match.score += CASE_MATCH_BONUS;
+    matches.append(match);
+  }
+
+  // not enough prefix matches, try fuzzy matching on the other names
+  if(matches.size() < maxCount) {
+    quint64 mask = charMask(key.folded);
+    for(const Entry* entry = begin; entry < end; ++entry) {
+      if(entry >= first && entry < last) // already matched as prefix
+        continue;
+      if((entry->charMask & mask) != mask)
+        continue;
+      int score = fuzzyScore(*entry, key.folded);
+      if(score > 0) {
+        Match match;
+        match.index = entry - begin;
+        match.score = score;
+        matches.append(match);
+      }
+    }
+  }
+
+  // only the best maxCount matches need to be sorted
+  if(matches.size() > maxCount) {
+    std::partial_sort(matches.begin(), matches.begin() + maxCount, matches.end(), matchLessThan);
+    matches.resize(maxCount);
+  }
+  else
+    std::sort(matches.begin(), matches.end(), matchLessThan);
+  result.reserve(matches.size());
+  Q_FOREACH(const Match& match, matches) {
+    result.append(entries_[match.index].name);
+  }
+  return result;
+}
+
+// A cached listing of the sub directories of a folder.
+// Listings of native folders are kept up to date with a file monitor.
+// For others, we revalidate the listing against the mtime of the folder.
+struct DirCacheEntry {
+  DirCacheEntry():
+    mtime(0),
+    monitor(NULL),
+    dirty(false) {
+  }
+
+  ~DirCacheEntry() {
+    if(monitor) {
+      g_signal_handlers_disconnect_by_func(monitor, (gpointer)onMonitorChanged, this);
+      g_object_unref(monitor);
+    }
+  }
+
+  static void onMonitorChanged(GFileMonitor* monitor, GFile* gf, GFile* other, GFileMonitorEvent evt, DirCacheEntry* entry) {
+    switch(evt) {
+    case G_FILE_MONITOR_EVENT_CHANGED:
+    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+    case G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED:
+      break; // these do not change the list of sub dirs
+    default:
+      entry->dirty = true;
+    }
+  }
+
+  QSharedPointer<PathCompletionIndex> index;
+  guint64 mtime;
+  GFileMonitor* monitor;
+  bool dirty;
+};
+
+// LRU cache of directory listings shared by all PathEdit instances
+class DirCache {
+public:
+  ~DirCache() {
+    qDeleteAll(entries_);
+  }
+
+  // find a cached listing and mark it as the most recently used one
+  DirCacheEntry* lookup(const QByteArray& uri) {
+    DirCacheEntry* entry = entries_.value(uri, NULL);
+    if(entry) {
+      lru_.removeOne(uri);
+      lru_.prepend(uri);
+    }
+    return entry;
+  }
+
+  DirCacheEntry* insert(const QByteArray& uri) {
+    DirCacheEntry* entry = lookup(uri);
+    if(!entry) {
+      if(lru_.size() >= DIR_CACHE_SIZE) { // remove the least recently used listing
+        QByteArray oldest = lru_.takeLast();
+        delete entries_.take(oldest);
+      }
+      entry = new DirCacheEntry();
+      entries_.insert(uri, entry);
+      lru_.prepend(uri);
+    }
+    return entry;
+  }
+
+private:
+  QHash<QByteArray, DirCacheEntry*> entries_;
+  QList<QByteArray> lru_;
+};
+
+static DirCache* dirCache = NULL;
+
 PathEdit::PathEdit(QWidget* parent):
   QLineEdit(parent),
   cancellable_(NULL),
@@ -34,7 +257,11 @@ PathEdit::PathEdit(QWidget* parent):
   completer_(new QCompleter()) {
   setCompleter(completer_);
   completer_->setModel(model_);
+  // we filter and rank the items ourselves in updateCompletionList().
+  completer_->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
   connect(this, SIGNAL(textChanged(QString)), SLOT(onTextChanged(QString)));
+  if(!dirCache)
+    dirCache = new DirCache();
 }
 
 PathEdit::~PathEdit() {
@@ -56,6 +283,7 @@ void PathEdit::focusInEvent(QFocusEvent* e) {
 void PathEdit::focusOutEvent(QFocusEvent* e) {
   QLineEdit::focusOutEvent(e);
   // free the completion list since we don't need it anymore
+  // the dir listing is still kept in the shared cache, though.
   freeCompleter();
 }
 
@@ -74,15 +302,30 @@ void PathEdit::onTextChanged(const QString& text) {
     if(hasFocus())
       reloadCompleter(false);
   }
+  else // we're still in the same dir, so only query the index again.
+    updateCompletionList();
 }
 
 struct JobData {
   GCancellable* cancellable;
   GFile* dirName;
+  QByteArray uri;
   QStringList subDirs;
+  QSharedPointer<PathCompletionIndex> index;
+  guint64 mtime;
+  guint64 cachedMtime;
+  bool revalidate; // only check if the cached listing is outdated
+  bool unchanged;
   PathEdit* edit;
   bool triggeredByFocusInEvent;
 
+  JobData():
+    mtime(0),
+    cachedMtime(0),
+    revalidate(false),
+    unchanged(false) {
+  }
+
   ~JobData() {
     g_object_unref(dirName);
     g_object_unref(cancellable);
@@ -100,14 +343,47 @@ void PathEdit::reloadCompleter(bool triggeredByFocusInEvent) {
   if(cancellable_) {
     g_cancellable_cancel(cancellable_);
     g_object_unref(cancellable_);
+    cancellable_ = NULL;
   }
+  // need to use fm_file_new_for_commandline_arg() rather than g_file_new_for_commandline_arg().
+  // otherwise, our own vfs, such as menu://, won't be loaded.
+  GFile* dirName = fm_file_new_for_commandline_arg(currentPrefix_.toLocal8Bit().constData());
+  char* uri = g_file_get_uri(dirName);
+  QByteArray dirUri(uri);
+  g_free(uri);
+
+  // if the dir is already loaded somewhere, say, opened in a tab,
+  // use its in-memory file list and skip the I/O entirely.
+  // the list is in memory already so building the index here is cheap.
+  QStringList subDirs;
+  if(subDirsFromLoadedFolder(dirName, subDirs)) {
+    setCompletionIndex(QSharedPointer<PathCompletionIndex>(new PathCompletionIndex(subDirs)), !triggeredByFocusInEvent);
+    g_object_unref(dirName);
+    return;
+  }
+
+  // see if we already have a listing of the dir in the cache
+  DirCacheEntry* entry = dirCache->lookup(dirUri);
+  if(entry && !entry->dirty) {
+    setCompletionIndex(entry->index, !triggeredByFocusInEvent);
+    // listings with a working file monitor are always up to date.
+    if(entry->monitor) {
+      g_object_unref(dirName);
+      return;
+    }
+  }
+
   // launch a new job to do dir listing
   JobData* data = new JobData();
   data->edit = this;
   data->triggeredByFocusInEvent = triggeredByFocusInEvent;
-  // need to use fm_file_new_for_commandline_arg() rather than g_file_new_for_commandline_arg().
-  // otherwise, our own vfs, such as menu://, won't be loaded.
-  data->dirName = fm_file_new_for_commandline_arg(currentPrefix_.toLocal8Bit().constData());
+  data->dirName = dirName;
+  data->uri = dirUri;
+  if(entry && !entry->dirty) {
+    // show the cached list now, and reload it later only if the dir is changed.
+    data->revalidate = true;
+    data->cachedMtime = entry->mtime;
+  }
   // qDebug("load: %s", g_file_get_uri(data->dirName));
   cancellable_ = g_cancellable_new();
   data->cancellable = (GCancellable*)g_object_ref(cancellable_);
@@ -116,18 +392,85 @@ void PathEdit::reloadCompleter(bool triggeredByFocusInEvent) {
                           G_PRIORITY_LOW, cancellable_);
 }
 
+// static
+bool PathEdit::subDirsFromLoadedFolder(GFile* dirName, QStringList& subDirs) {
+  FmPath* dirPath = fm_path_new_for_gfile(dirName);
+  // only find existing folders. don't create new ones.
+  FmFolder* folder = fm_folder_find_by_path(dirPath);
+  fm_path_unref(dirPath);
+  if(!folder)
+    return false;
+  bool loaded = fm_folder_is_loaded(folder);
+  if(loaded) {
+    CachedFolderModel* model = CachedFolderModel::findModel(folder);
+    if(model) { // the model already has display names converted to QString
+      int n = model->rowCount();
+      for(int row = 0; row < n; ++row) {
+        FolderModelItem* item = model->itemFromIndex(model->index(row, 0));
+        if(fm_file_info_is_dir(item->info))
+          subDirs.append(item->displayName);
+      }
+    }
+    else {
+      FmFileInfoList* files = fm_folder_get_files(folder);
+      for(GList* l = fm_file_info_list_peek_head_link(files); l; l = l->next) {
+        FmFileInfo* info = FM_FILE_INFO(l->data);
+        if(fm_file_info_is_dir(info))
+          subDirs.append(QString::fromUtf8(fm_file_info_get_disp_name(info)));
+      }
+    }
+  }
+  g_object_unref(folder);
+  return loaded;
+}
+
 void PathEdit::freeCompleter() {
   if(cancellable_) {
     g_cancellable_cancel(cancellable_);
     g_object_unref(cancellable_);
     cancellable_ = NULL;
   }
+  index_.clear();
   model_->setStringList(QStringList());
 }
 
+void PathEdit::setCompletionIndex(const QSharedPointer<PathCompletionIndex>& index, bool triggerCompletion) {
+  index_ = index;
+  updateCompletionList();
+  // trigger completion manually
+  if(hasFocus() && triggerCompletion)
+    completer_->complete();
+}
+
+// query the index with the part of the text after the last '/'.
+void PathEdit::updateCompletionList() {
+  if(!index_)
+    return;
+  QStringList matches = index_->query(text().mid(currentPrefix_.length()), MAX_COMPLETIONS);
+  QStringList list;
+  list.reserve(matches.size());
+  Q_FOREACH(const QString& subDir, matches) {
+    list.append(currentPrefix_ % subDir);
+  }
+  model_->setStringList(list);
+}
+
 gboolean PathEdit::jobFunc(GIOSchedulerJob* job, GCancellable* cancellable, gpointer user_data) {
   JobData* data = reinterpret_cast<JobData*>(user_data);
   GError *err = NULL;
+  GFileInfo* dirInfo = g_file_query_info(data->dirName, G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                         G_FILE_QUERY_INFO_NONE, cancellable, NULL);
+  if(dirInfo) {
+    data->mtime = g_file_info_get_attribute_uint64(dirInfo, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+    g_object_unref(dirInfo);
+  }
+  if(data->revalidate && data->mtime != 0 && data->mtime == data->cachedMtime) {
+    // the cached listing is still valid. no need to enumerate the dir again.
+    data->unchanged = true;
+    g_io_scheduler_job_send_to_mainloop(job, _onJobFinished, data, NULL);
+    return FALSE;
+  }
+
   GFileEnumerator* enu = g_file_enumerate_children(data->dirName,
                                                    // G_FILE_ATTRIBUTE_STANDARD_NAME","
                                                    G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME","
@@ -158,6 +501,9 @@ gboolean PathEdit::jobFunc(GIOSchedulerJob* job, GCancellable* cancellable, gpoi
     g_file_enumerator_close(enu, cancellable, NULL);
     g_object_unref(enu);
   }
+  // build the index here so sorting a large listing won't block the UI
+  if(!g_cancellable_is_cancelled(cancellable))
+    data->index = QSharedPointer<PathCompletionIndex>(new PathCompletionIndex(data->subDirs));
   // finished! let's update the UI in the main thread
   g_io_scheduler_job_send_to_mainloop(job, _onJobFinished, data, NULL);
   return FALSE;
@@ -166,26 +512,30 @@ gboolean PathEdit::jobFunc(GIOSchedulerJob* job, GCancellable* cancellable, gpoi
 // static
 gboolean PathEdit::_onJobFinished(gpointer user_data) {
   JobData* data = reinterpret_cast<JobData*>(user_data);
-  data->edit->onJobFinished(data);
+  // if the job is cancelled, the PathEdit may already be deleted.
+  if(!g_cancellable_is_cancelled(data->cancellable))
+    data->edit->onJobFinished(data);
   return TRUE;
 }
 
 // This callback function is called from main thread so it's safe to access the GUI
 void PathEdit::onJobFinished(JobData* data) {
-  if(!g_cancellable_is_cancelled(data->cancellable)) {
-    // update the completer only if the job is not cancelled
-    QStringList::iterator it;
-    for(it = data->subDirs.begin(); it != data->subDirs.end(); ++it) {
-      // qDebug("%s", it->toUtf8().constData());
-      *it = (currentPrefix_ % *it);
+  if(!data->unchanged) {
+    // store the new listing in the cache
+    DirCacheEntry* entry = dirCache->insert(data->uri);
+    entry->index = data->index;
+    entry->mtime = data->mtime;
+    entry->dirty = false;
+    // file monitors need to be created in the main thread.
+    // only monitor native dirs since monitoring remote ones is not reliable.
+    if(!entry->monitor && g_file_is_native(data->dirName)) {
+      entry->monitor = fm_monitor_directory(data->dirName, NULL);
+      if(entry->monitor)
+        g_signal_connect(entry->monitor, "changed", G_CALLBACK(DirCacheEntry::onMonitorChanged), entry);
     }
-    model_->setStringList(data->subDirs);
-    // trigger completion manually
-    if(hasFocus() && !data->triggeredByFocusInEvent)
-      completer_->complete();
+    // update the completer only if the job is not cancelled
+    setCompletionIndex(data->index, !data->triggeredByFocusInEvent);
   }
-  else
-    model_->setStringList(QStringList());
   if(cancellable_) {
     g_object_unref(cancellable_);
     cancellable_ = NULL;
@@ -23,6 +23,8 @@
 
 #include "libfmqtglobals.h"
 #include <QLineEdit>
+#include <QStringList>
+#include <QSharedPointer>
 #include <gio/gio.h>
 
 class QCompleter;
@@ -31,6 +33,7 @@ class QStringListModel;
 namespace Fm {
 
 struct JobData;
+class PathCompletionIndex;
 
 class LIBFM_QT_API PathEdit : public QLineEdit {
 Q_OBJECT
@@ -48,6 +51,9 @@ private Q_SLOTS:
 private:
   void reloadCompleter(bool triggeredByFocusInEvent = false);
   void freeCompleter();
+  void setCompletionIndex(const QSharedPointer<PathCompletionIndex>& index, bool triggerCompletion);
+  void updateCompletionList();
+  static bool subDirsFromLoadedFolder(GFile* dirName, QStringList& subDirs);
   static gboolean jobFunc(GIOSchedulerJob *job, GCancellable *cancellable, gpointer user_data);
   static gboolean _onJobFinished(gpointer user_data);
   void onJobFinished(JobData* data);
@@ -57,6 +63,7 @@ private:
   QStringListModel* model_;
   QString currentPrefix_;
   GCancellable* cancellable_;
+  QSharedPointer<PathCompletionIndex> index_; // sub dirs of currentPrefix_
 };
 
 }
@@ -0,0 +1,72 @@
+/*
+
+    Copyright (C) 2013  Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#ifndef FM_PATHEDIT_P_H
+#define FM_PATHEDIT_P_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+namespace Fm {
+
+// Index of the sub dir names of a folder used by PathEdit.
+// It's built in a worker thread once per dir listing, and then
+// queried in the main thread for every keystroke.
+class PathCompletionIndex {
+public:
+  explicit PathCompletionIndex(const QStringList& names);
+
+  int size() const {
+    return entries_.size();
+  }
+
+  // return at most maxCount names matching the pattern, the best ones first.
+  // names starting with the pattern rank first, followed by names
+  // containing the chars of the pattern in order (fuzzy matching).
+  // an empty pattern matches every name, and only the first maxCount
+  // names in alphabetical order are returned. more specific names are
+  // found by typing more chars.
+  QStringList query(const QString& pattern, int maxCount) const;
+
+private:
+  struct Entry {
+    QString name;
+    QString folded; // lower case name used for matching
+    quint64 charMask; // set of chars in the folded name
+  };
+
+  struct Match {
+    int score;
+    int index;
+  };
+
+  static quint64 charMask(const QString& str);
+  static int fuzzyScore(const Entry& entry, const QString& pattern);
+  static bool entryLessThan(const Entry& a, const Entry& b);
+  static bool matchLessThan(const Match& a, const Match& b);
+
+private:
+  QVector<Entry> entries_; // sorted by folded names
+};
+
+}
+
+#endif // FM_PATHEDIT_P_H
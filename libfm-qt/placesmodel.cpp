@@ -26,18 +26,39 @@
 #include <QTimer>
 #include "utilities.h"
 #include "placesmodelitem.h"
+#include "trace.h"
 
 using namespace Fm;
 
+// min interval between two updates of the trash icon in milliseconds
+#define TRASH_UPDATE_INTERVAL   1000
+// volume-changed and mount-changed signals received in this interval
+// are handled together, in milliseconds
+#define DEVICE_UPDATE_DELAY     200
+
 PlacesModel::PlacesModel(QObject* parent):
   QStandardItemModel(parent),
   showApplications_(true),
   showDesktop_(true),
+  trashMonitor_(NULL),
+  trashUpdateTimer_(new QTimer(this)),
+  trashCancellable_(NULL),
+  trashUpdateQueued_(false),
+  trashFull_(-1),
+  deviceUpdateTimer_(new QTimer(this)),
+  changedVolumes_(NULL),
+  changedMounts_(NULL),
   ejectIcon_(QIcon::fromTheme("media-eject")) {
+  TraceScope trace("PlacesModel::PlacesModel");
 
   setColumnCount(2);
 
-  PlacesModelItem* item;
+  // moving many files to the trash can emits a flood of change notifications.
+  // all of them received in the interval are handled with one update.
+  trashUpdateTimer_->setSingleShot(true);
+  trashUpdateTimer_->setInterval(TRASH_UPDATE_INTERVAL);
+  connect(trashUpdateTimer_, SIGNAL(timeout()), SLOT(updateTrash()));
+
   placesRoot = new QStandardItem(tr("Places"));
   placesRoot->setEditable(false);
   placesRoot->setSelectable(false);
@@ -99,30 +120,12 @@ PlacesModel::PlacesModel(QObject* parent):
     g_signal_connect(volumeMonitor, "mount-removed", G_CALLBACK(onMountRemoved), this);
   }
 
-  // add volumes to side-pane
-  GList* vols = g_volume_monitor_get_volumes(volumeMonitor);
-  GList* l;
-  for(l = vols; l; l = l->next) {
-    GVolume* volume = G_VOLUME(l->data);
-    onVolumeAdded(volumeMonitor, volume, this);
-    g_object_unref(volume);
-  }
-  g_list_free(vols);
+  // there can be many of them. add them after the window is shown.
+  QTimer::singleShot(0, this, SLOT(loadDevices()));
 
-  /* add mounts to side-pane */
-  vols = g_volume_monitor_get_mounts(volumeMonitor);
-  for(l = vols; l; l = l->next) {
-    GMount* mount = G_MOUNT(l->data);
-    GVolume* volume = g_mount_get_volume(mount);
-    if(volume)
-      g_object_unref(volume);
-    else { /* network mounts or others */
-      item = new PlacesModelMountItem(mount);
-      devicesRoot->appendRow(item);
-    }
-    g_object_unref(mount);
-  }
-  g_list_free(vols);
+  deviceUpdateTimer_->setSingleShot(true);
+  deviceUpdateTimer_->setInterval(DEVICE_UPDATE_DELAY);
+  connect(deviceUpdateTimer_, SIGNAL(timeout()), SLOT(updateChangedDevices()));
 
   // bookmarks
   bookmarksRoot = new QStandardItem(tr("Bookmarks"));
@@ -139,6 +142,28 @@ PlacesModel::PlacesModel(QObject* parent):
   connect(IconTheme::instance(), SIGNAL(changed()), SLOT(updateIcons()));
 }
 
+// add volumes and mounts to side-pane
+void PlacesModel::loadDevices() {
+  TraceScope trace("PlacesModel::loadDevices");
+  if(!volumeMonitor)
+    return;
+  GList* vols = g_volume_monitor_get_volumes(volumeMonitor);
+  for(GList* l = vols; l; l = l->next) {
+    GVolume* volume = G_VOLUME(l->data);
+    onVolumeAdded(volumeMonitor, volume, this);
+    g_object_unref(volume);
+  }
+  g_list_free(vols);
+
+  GList* mounts = g_volume_monitor_get_mounts(volumeMonitor);
+  for(GList* l = mounts; l; l = l->next) {
+    GMount* mount = G_MOUNT(l->data);
+    onMountAdded(volumeMonitor, mount, this);
+    g_object_unref(mount);
+  }
+  g_list_free(mounts);
+}
+
 void PlacesModel::loadBookmarks() {
   GList* allBookmarks = fm_bookmarks_get_all(bookmarks);
   for(GList* l = allBookmarks; l; l = l->next) {
@@ -168,32 +193,74 @@ PlacesModel::~PlacesModel() {
       g_signal_handlers_disconnect_by_func(trashMonitor_, (gpointer)G_CALLBACK(onTrashChanged), this);
       g_object_unref(trashMonitor_);
   }
+
+  if(trashCancellable_) {
+    g_cancellable_cancel(trashCancellable_);
+    g_object_unref(trashCancellable_);
+  }
+
+  g_list_free_full(changedVolumes_, g_object_unref);
+  g_list_free_full(changedMounts_, g_object_unref);
 }
 
 // static
 void PlacesModel::onTrashChanged(GFileMonitor* monitor, GFile* gf, GFile* other, GFileMonitorEvent evt, PlacesModel* pThis) {
-  QTimer::singleShot(0, pThis, SLOT(updateTrash()));
+  if(!pThis->trashUpdateTimer_->isActive())
+    pThis->trashUpdateTimer_->start();
 }
 
+// counting the items may enumerate the whole trash can, so it's done asynchronously.
 void PlacesModel::updateTrash() {
-  if(trashItem_) {
-    GFile* gf = fm_file_new_for_uri("trash:///");
-    GFileInfo* inf = g_file_query_info(gf, G_FILE_ATTRIBUTE_TRASH_ITEM_COUNT, G_FILE_QUERY_INFO_NONE, NULL, NULL);
-    g_object_unref(gf);
-    if(inf) {
-      guint32 n = g_file_info_get_attribute_uint32(inf, G_FILE_ATTRIBUTE_TRASH_ITEM_COUNT);
-      g_object_unref(inf);
-      const char* icon_name = n > 0 ? "user-trash-full" : "user-trash";
-      FmIcon* icon = fm_icon_from_name(icon_name);
-      trashItem_->setIcon(icon);
+  if(!trashItem_)
+    return;
+  if(trashCancellable_) { // a query is still running. do it again after it's done.
+    trashUpdateQueued_ = true;
+    return;
+  }
+  GFile* gf = fm_file_new_for_uri("trash:///");
+  trashCancellable_ = g_cancellable_new();
+  g_file_query_info_async(gf, G_FILE_ATTRIBUTE_TRASH_ITEM_COUNT, G_FILE_QUERY_INFO_NONE,
+                          G_PRIORITY_LOW, trashCancellable_,
+                          (GAsyncReadyCallback)onTrashInfoFinished, this);
+  g_object_unref(gf);
+}
+
+// static
+void PlacesModel::onTrashInfoFinished(GFile* gf, GAsyncResult* res, PlacesModel* pThis) {
+  GError* err = NULL;
+  GFileInfo* inf = g_file_query_info_finish(gf, res, &err);
+  if(err) {
+    bool cancelled = g_error_matches(err, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+    g_error_free(err);
+    if(cancelled) // the model is being deleted
+      return;
+  }
+  g_object_unref(pThis->trashCancellable_);
+  pThis->trashCancellable_ = NULL;
+
+  if(inf) {
+    guint32 n = g_file_info_get_attribute_uint32(inf, G_FILE_ATTRIBUTE_TRASH_ITEM_COUNT);
+    g_object_unref(inf);
+    int full = n > 0 ? 1 : 0;
+    if(pThis->trashItem_ && full != pThis->trashFull_) { // only change the icon when needed
+      pThis->trashFull_ = full;
+      FmIcon* icon = fm_icon_from_name(full ? "user-trash-full" : "user-trash");
+      pThis->trashItem_->setIcon(icon);
       fm_icon_unref(icon);
     }
   }
+
+  if(pThis->trashUpdateQueued_) {
+    pThis->trashUpdateQueued_ = false;
+    if(!pThis->trashUpdateTimer_->isActive())
+      pThis->trashUpdateTimer_->start();
+  }
 }
 
 void PlacesModel::createTrashItem() {
   trashItem_ = new PlacesModelItem("user-trash", tr("Trash"), fm_path_get_trash());
   trashItem_->setEditable(false);
+  trashFull_ = -1;
 
   GFile* gf;
   gf = fm_file_new_for_uri("trash:///");
@@ -325,10 +392,12 @@ void PlacesModel::onMountAdded(GVolumeMonitor* monitor, GMount* mount, PlacesMod
   }
 }
 
+// devices may emit change signals repeatedly. handle them later in a batch.
 void PlacesModel::onMountChanged(GVolumeMonitor* monitor, GMount* mount, PlacesModel* pThis) {
-  PlacesModelMountItem* item = pThis->itemFromMount(mount);
-  if(item)
-    item->update();
+  if(!g_list_find(pThis->changedMounts_, mount))
+    pThis->changedMounts_ = g_list_prepend(pThis->changedMounts_, g_object_ref(mount));
+  if(!pThis->deviceUpdateTimer_->isActive())
+    pThis->deviceUpdateTimer_->start();
 }
 
 void PlacesModel::onMountRemoved(GVolumeMonitor* monitor, GMount* mount, PlacesModel* pThis) {
@@ -344,6 +413,11 @@ void PlacesModel::onMountRemoved(GVolumeMonitor* monitor, GMount* mount, PlacesM
       pThis->devicesRoot->removeRow(item->row());
     }
   }
+  GList* l = g_list_find(pThis->changedMounts_, mount);
+  if(l) {
+    g_object_unref(mount);
+    pThis->changedMounts_ = g_list_delete_link(pThis->changedMounts_, l);
+  }
 }
 
 void PlacesModel::onVolumeAdded(GVolumeMonitor* monitor, GVolume* volume, PlacesModel* pThis) {
@@ -360,16 +434,10 @@ void PlacesModel::onVolumeAdded(GVolumeMonitor* monitor, GVolume* volume, Places
 }
 
 void PlacesModel::onVolumeChanged(GVolumeMonitor* monitor, GVolume* volume, PlacesModel* pThis) {
-  PlacesModelVolumeItem* item = pThis->itemFromVolume(volume);
-  if(item) {
-    item->update();
-    if(!item->isMounted()) { // the volume is unmounted, remove the eject button if needed
-      // remove the eject button for the volume (at column 1 of the same row)
-      QStandardItem* ejectBtn = item->parent()->child(item->row(), 1);
-      Q_ASSERT(ejectBtn);
-      ejectBtn->setIcon(QIcon());
-    }
-  }
+  if(!g_list_find(pThis->changedVolumes_, volume))
+    pThis->changedVolumes_ = g_list_prepend(pThis->changedVolumes_, g_object_ref(volume));
+  if(!pThis->deviceUpdateTimer_->isActive())
+    pThis->deviceUpdateTimer_->start();
 }
 
 void PlacesModel::onVolumeRemoved(GVolumeMonitor* monitor, GVolume* volume, PlacesModel* pThis) {
@@ -377,6 +445,40 @@ void PlacesModel::onVolumeRemoved(GVolumeMonitor* monitor, GVolume* volume, Plac
   if(item) {
     pThis->devicesRoot->removeRow(item->row());
   }
+  GList* l = g_list_find(pThis->changedVolumes_, volume);
+  if(l) {
+    g_object_unref(volume);
+    pThis->changedVolumes_ = g_list_delete_link(pThis->changedVolumes_, l);
+  }
+}
+
+void PlacesModel::updateChangedDevices() {
+  for(GList* l = changedVolumes_; l; l = l->next) {
+    GVolume* volume = G_VOLUME(l->data);
+    PlacesModelVolumeItem* item = itemFromVolume(volume);
+    if(item) {
+      item->update();
+      if(!item->isMounted()) { // the volume is unmounted, remove the eject button if needed
+        // remove the eject button for the volume (at column 1 of the same row)
+        QStandardItem* ejectBtn = item->parent()->child(item->row(), 1);
+        Q_ASSERT(ejectBtn);
+        ejectBtn->setIcon(QIcon());
+      }
+    }
+    g_object_unref(volume);
+  }
+  g_list_free(changedVolumes_);
+  changedVolumes_ = NULL;
+
+  for(GList* l = changedMounts_; l; l = l->next) {
+    GMount* mount = G_MOUNT(l->data);
+    PlacesModelMountItem* item = itemFromMount(mount);
+    if(item)
+      item->update();
+    g_object_unref(mount);
+  }
+  g_list_free(changedMounts_);
+  changedMounts_ = NULL;
 }
 
 void PlacesModel::onBookmarksChanged(FmBookmarks* bookmarks, PlacesModel* pThis) {
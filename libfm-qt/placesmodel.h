@@ -26,6 +26,7 @@
 #include <QStandardItem>
 #include <QList>
 #include <QAction>
+#include <QTimer>
 #include <libfm/fm.h>
 
 namespace Fm {
@@ -78,6 +79,10 @@ public Q_SLOTS:
   void updateIcons();
   void updateTrash();
 
+private Q_SLOTS:
+  void loadDevices();
+  void updateChangedDevices();
+
 protected:
   
   PlacesModelItem* itemFromPath(FmPath* path);
@@ -107,6 +112,7 @@ private:
   static void onBookmarksChanged(FmBookmarks* bookmarks, PlacesModel* pThis);
 
   static void onTrashChanged(GFileMonitor *monitor, GFile *gf, GFile *other, GFileMonitorEvent evt, PlacesModel* pThis);
+  static void onTrashInfoFinished(GFile* gf, GAsyncResult* res, PlacesModel* pThis);
 private:
   FmBookmarks* bookmarks;
   GVolumeMonitor* volumeMonitor;
@@ -118,6 +124,13 @@ private:
   QStandardItem* bookmarksRoot;
   PlacesModelItem* trashItem_;
   GFileMonitor* trashMonitor_;
+  QTimer* trashUpdateTimer_;
+  GCancellable* trashCancellable_; // set while the item count is being queried
+  bool trashUpdateQueued_;
+  int trashFull_; // -1 if unknown
+  QTimer* deviceUpdateTimer_;
+  GList* changedVolumes_; // devices with pending updates
+  GList* changedMounts_;
   PlacesModelItem* desktopItem;
   PlacesModelItem* homeItem;
   PlacesModelItem* computerItem;
@@ -72,6 +72,10 @@ void PlacesModelItem::setPath(FmPath* path) {
 }
 
 void PlacesModelItem::setIcon(FmIcon* icon) {
+  // FmIcon objects are cached, so the same icon is the same object.
+  // skip converting it to a QIcon again.
+  if(icon == icon_)
+    return;
   if(icon_)
     fm_icon_unref(icon_);
   if(icon) {
@@ -90,6 +94,11 @@ void PlacesModelItem::setIcon(GIcon* gicon) {
   fm_icon_unref(icon);
 }
 
+void PlacesModelItem::setTextIfChanged(const QString& text) {
+  if(text != QStandardItem::text())
+    setText(text);
+}
+
 void PlacesModelItem::updateIcon() {
   if(icon_)
     QStandardItem::setIcon(IconTheme::icon(icon_));
@@ -125,9 +134,12 @@ PlacesModelVolumeItem::PlacesModelVolumeItem(GVolume* volume):
   setEditable(false);
 }
 
+// only the changed data is set, since each change is signalled to the views
 void PlacesModelVolumeItem::update() {
   // set title
-  setText(QString::fromUtf8(g_volume_get_name(volume_)));
+  char* name = g_volume_get_name(volume_);
+  setTextIfChanged(QString::fromUtf8(name));
+  g_free(name);
   
   // set icon
   GIcon* gicon = g_volume_get_icon(volume_);
@@ -139,7 +151,8 @@ void PlacesModelVolumeItem::update() {
   if(mount) {
     GFile* mount_root = g_mount_get_root(mount);
     FmPath* mount_path = fm_path_new_for_gfile(mount_root);
-    setPath(mount_path);
+    if(!path() || !fm_path_equal(path(), mount_path))
+      setPath(mount_path);
     fm_path_unref(mount_path);
     g_object_unref(mount_root);
     g_object_unref(mount);
@@ -167,12 +180,15 @@ PlacesModelMountItem::PlacesModelMountItem(GMount* mount):
 
 void PlacesModelMountItem::update() {
   // set title
-  setText(QString::fromUtf8(g_mount_get_name(mount_)));
+  char* name = g_mount_get_name(mount_);
+  setTextIfChanged(QString::fromUtf8(name));
+  g_free(name);
   
   // set path
   GFile* mount_root = g_mount_get_root(mount_);
   FmPath* mount_path = fm_path_new_for_gfile(mount_root);
-  setPath(mount_path);
+  if(!path() || !fm_path_equal(path(), mount_path))
+    setPath(mount_path);
   fm_path_unref(mount_path);
   g_object_unref(mount_root);
   
@@ -63,6 +63,7 @@ public:
   void setIcon(FmIcon* icon);
   void setIcon(GIcon* gicon);
   void updateIcon();
+  void setTextIfChanged(const QString& text);
 
   QVariant data(int role = Qt::UserRole + 1) const;
 
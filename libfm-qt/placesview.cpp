@@ -30,7 +30,7 @@
 
 using namespace Fm;
 
-PlacesView::PlacesView(QWidget* parent):
+PlacesView::PlacesView(QWidget* parent, PlacesModel* model):
   QTreeView(parent),
   currentPath_(NULL) {
   setRootIsDecorated(false);
@@ -41,8 +41,7 @@ PlacesView::PlacesView(QWidget* parent):
   
   setIconSize(QSize(24, 24));
   
-  // FIXME: we may share this model amont all views
-  model_ = new PlacesModel(this);
+  model_ = model ? model : new PlacesModel(this);
   setModel(model_);
   QHeaderView* headerView = header();
 #if QT_VERSION >= 0x050000
@@ -34,7 +34,8 @@ class LIBFM_QT_API PlacesView : public QTreeView {
 Q_OBJECT
 
 public:
-  explicit PlacesView(QWidget* parent = 0);
+  // a model shared with other views can be given, or the view creates its own one
+  explicit PlacesView(QWidget* parent = 0, PlacesModel* model = NULL);
   virtual ~PlacesView();
 
   void setCurrentPath(FmPath* path);
@@ -28,7 +28,8 @@ ProxyFolderModel::ProxyFolderModel(QObject * parent):
   thumbnailSize_(0),
   showHidden_(false),
   showThumbnails_(false),
-  folderFirst_(true) {
+  folderFirst_(true),
+  narrowing_(false) {
   setDynamicSortFilter(true);
   setSortCaseSensitivity(Qt::CaseInsensitive);
 }
@@ -94,6 +95,9 @@ void ProxyFolderModel::setFolderFirst(bool folderFirst) {
 }
 
 bool ProxyFolderModel::filterAcceptsRow(int source_row, const QModelIndex & source_parent) const {
+  // rows hidden before narrowing the filters cannot be accepted now
+  if(narrowing_ && !shownRows_.testBit(source_row))
+    return false;
   if(!showHidden_) {
     QAbstractItemModel* srcModel = sourceModel();
     QString name = srcModel->data(srcModel->index(source_row, 0, source_parent)).toString();
@@ -101,11 +105,13 @@ bool ProxyFolderModel::filterAcceptsRow(int source_row, const QModelIndex & sour
       return false;
   }
   // apply additional filters if there're any
-  Q_FOREACH(ProxyFolderModelFilter* filter, filters_) {
+  if(!filters_.isEmpty()) {
     FolderModel* srcModel = static_cast<FolderModel*>(sourceModel());
     FmFileInfo* fileInfo = srcModel->fileInfoFromIndex(srcModel->index(source_row, 0, source_parent));
-    if(!filter->filterAcceptsRow(this, fileInfo))
-      return false;
+    Q_FOREACH(ProxyFolderModelFilter* filter, filters_) {
+      if(!filter->filterAcceptsRow(this, fileInfo))
+        return false;
+    }
   }
   return true;
 }
@@ -232,6 +238,24 @@ void ProxyFolderModel::removeFilter(ProxyFolderModelFilter* filter) {
   Q_EMIT sortFilterChanged();  
 }
 
+void ProxyFolderModel::updateFilters(bool narrowing) {
+  QAbstractItemModel* srcModel = sourceModel();
+  if(narrowing && srcModel) {
+    // remember the rows shown now, so filterAcceptsRow() can reject
+    // all the other rows without testing them.
+    shownRows_.resize(srcModel->rowCount());
+    shownRows_.fill(false);
+    int n = rowCount();
+    for(int row = 0; row < n; ++row)
+      shownRows_.setBit(mapToSource(index(row, 0)).row());
+    narrowing_ = true;
+  }
+  invalidateFilter();
+  narrowing_ = false;
+  shownRows_.clear();
+  Q_EMIT sortFilterChanged();
+}
+
 
 #if 0
 void ProxyFolderModel::reloadAllThumbnails() {
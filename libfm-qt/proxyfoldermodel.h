@@ -25,6 +25,7 @@
 #include <QSortFilterProxyModel>
 #include <libfm/fm.h>
 #include <QList>
+#include <QBitArray>
 
 namespace Fm {
 
@@ -83,6 +84,10 @@ public:
 
   void addFilter(ProxyFolderModelFilter* filter);
   void removeFilter(ProxyFolderModelFilter* filter);
+  // apply the filters again after their conditions are changed.
+  // narrowing means the filters accept fewer files than before,
+  // so only the rows currently shown need to be tested again.
+  void updateFilters(bool narrowing = false);
 
 Q_SIGNALS:
   void sortFilterChanged();
@@ -103,6 +108,8 @@ private:
   bool showThumbnails_;
   int thumbnailSize_;
   QList<ProxyFolderModelFilter*> filters_;
+  bool narrowing_;
+  QBitArray shownRows_; // source rows shown before narrowing the filters
 };
 
 }
@@ -0,0 +1,67 @@
+/*
+
+    Copyright (C) 2013  Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+
+#include "searchfoldermodel.h"
+
+using namespace Fm;
+
+SearchFolderModel::SearchFolderModel(FileSearch* search):
+  FolderModel(),
+  search_(search) {
+  search_->setParent(this);
+  connect(search_, SIGNAL(filesFound(FmFileInfoList*)), SLOT(onFilesFound(FmFileInfoList*)));
+  connect(search_, SIGNAL(finished()), SIGNAL(searchFinished()));
+  search_->start();
+}
+
+SearchFolderModel::~SearchFolderModel() {
+  // stop the worker threads before the items are freed
+  search_->cancel();
+}
+
+int SearchFolderModel::columnCount(const QModelIndex& parent) const {
+  if(parent.isValid())
+    return 0;
+  // show the number of the matches when searching file contents
+  return search_->contentPattern().isEmpty() ? NumOfColumns : NumOfColumns + 1;
+}
+
+QVariant SearchFolderModel::data(const QModelIndex& index, int role) const {
+  if(index.isValid() && index.column() == ColumnMatches) {
+    if(role == Qt::DisplayRole) {
+      int matches = search_->matchCount(fileInfoFromIndex(index));
+      if(matches >= 0)
+        return QVariant(matches);
+    }
+    return QVariant();
+  }
+  return FolderModel::data(index, role);
+}
+
+QVariant SearchFolderModel::headerData(int section, Qt::Orientation orientation, int role) const {
+  if(section == ColumnMatches && orientation == Qt::Horizontal && role == Qt::DisplayRole)
+    return QVariant(tr("Matches"));
+  return FolderModel::headerData(section, orientation, role);
+}
+
+void SearchFolderModel::onFilesFound(FmFileInfoList* files) {
+  insertFiles(rowCount(), files);
+}
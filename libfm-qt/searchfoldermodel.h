@@ -0,0 +1,69 @@
+/*
+
+    Copyright (C) 2013  Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+
+#ifndef FM_SEARCHFOLDERMODEL_H
+#define FM_SEARCHFOLDERMODEL_H
+
+#include "libfmqtglobals.h"
+#include "foldermodel.h"
+#include "filesearch.h"
+
+namespace Fm {
+
+// A folder model showing the results of a file search.
+// The files are added while the search is running.
+class LIBFM_QT_API SearchFolderModel : public FolderModel {
+  Q_OBJECT
+public:
+  enum SearchColumnId {
+    ColumnMatches = NumOfColumns // number of the matches when searching file contents
+  };
+
+public:
+  // the model takes the ownership of the search and starts it
+  explicit SearchFolderModel(FileSearch* search);
+  virtual ~SearchFolderModel();
+
+  FileSearch* search() {
+    return search_;
+  }
+
+  bool isSearching() {
+    return search_->isRunning();
+  }
+
+  int columnCount(const QModelIndex& parent = QModelIndex()) const;
+  QVariant data(const QModelIndex& index, int role) const;
+  QVariant headerData(int section, Qt::Orientation orientation, int role) const;
+
+Q_SIGNALS:
+  void searchFinished();
+
+private Q_SLOTS:
+  void onFilesFound(FmFileInfoList* files);
+
+private:
+  FileSearch* search_;
+};
+
+}
+
+#endif // FM_SEARCHFOLDERMODEL_H
@@ -35,7 +35,10 @@ SidePane::SidePane(QWidget* parent):
   view_(NULL),
   combo_(NULL),
   currentPath_(NULL),
-  iconSize_(24, 24) {
+  iconSize_(24, 24),
+  placesModel_(NULL),
+  dirTreeModel_(NULL),
+  dirTreeModelProvider_(NULL) {
 
   verticalLayout = new QVBoxLayout(this);
   verticalLayout->setContentsMargins(0, 0, 0, 0);
@@ -157,31 +160,36 @@ bool SidePane::setHomeDir(const char* home_dir) {
 }
 
 void SidePane::initDirTree() {
-  // TODO
-  DirTreeModel* model = new DirTreeModel(view_);
-  FmFileInfoJob* job = fm_file_info_job_new(NULL, FM_FILE_INFO_JOB_NONE);
-
-  GList* l;
-  /* query FmFileInfo for home dir and root dir, and then,
-    * add them to dir tree model */
-  fm_file_info_job_add(job, fm_path_get_home());
-  fm_file_info_job_add(job, fm_path_get_root());
-  /* FIXME: maybe it's cleaner to use run_async here? */
-  fm_job_run_sync_with_mainloop(FM_JOB(job));
-  for(l = fm_file_info_list_peek_head_link(job->file_infos); l; l = l->next) {
-      FmFileInfo* fi = FM_FILE_INFO(l->data);
-      model->addRoot(fi);
+  if(!dirTreeModel_ && dirTreeModelProvider_)
+    dirTreeModel_ = dirTreeModelProvider_();
+  DirTreeModel* model = dirTreeModel_;
+  if(!model) { // no shared model is given
+    model = new DirTreeModel(view_);
+    /* query FmFileInfo for home dir and root dir, and then,
+      * add them to dir tree model */
+    FmPathList* paths = fm_path_list_new();
+    fm_path_list_push_tail(paths, fm_path_get_home());
+    fm_path_list_push_tail(paths, fm_path_get_root());
+    model->addRoots(paths);
+    fm_path_list_unref(paths);
   }
-  g_object_unref(job);
-
+  // the current path cannot be selected before the roots are added
+  connect(model, SIGNAL(rowsInserted(QModelIndex,int,int)), SLOT(onDirTreeRowsInserted(QModelIndex,int,int)));
   static_cast<DirTreeView*>(view_)->setModel(model);
 }
 
+void SidePane::onDirTreeRowsInserted(const QModelIndex& parent, int start, int end) {
+  if(!parent.isValid() && mode_ == ModeDirTree && currentPath_)
+    static_cast<DirTreeView*>(view_)->setCurrentPath(currentPath_);
+}
+
 void SidePane::setMode(Mode mode) {
   if(mode == mode_)
     return;
 
   if(view_) {
+    if(mode_ == ModeDirTree && dirTreeModel_)
+      dirTreeModel_->disconnect(this);
     delete view_;
     view_ = NULL;
     //if(sp->update_popup)
@@ -192,7 +200,7 @@ void SidePane::setMode(Mode mode) {
   combo_->setCurrentIndex(mode);
   switch(mode) {
   case ModePlaces: {
-    PlacesView* placesView = new Fm::PlacesView(this);
+    PlacesView* placesView = new Fm::PlacesView(this, placesModel_);
     view_ = placesView;
     placesView->setIconSize(iconSize_);
     placesView->setCurrentPath(currentPath_);
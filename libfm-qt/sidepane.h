@@ -28,9 +28,13 @@
 class QComboBox;
 class QVBoxLayout;
 class QWidget;
+class QModelIndex;
 
 namespace Fm {
 
+class PlacesModel;
+class DirTreeModel;
+
 class LIBFM_QT_API SidePane : public QWidget {
   Q_OBJECT
 
@@ -42,6 +46,9 @@ public:
       NumModes
   };
 
+  // returns the dir tree model shared with other side panes
+  typedef DirTreeModel* (*DirTreeModelProvider)();
+
 public:
   explicit SidePane(QWidget* parent = 0);
   virtual ~SidePane();
@@ -58,6 +65,17 @@ public:
 
   void setCurrentPath(FmPath* path);
 
+  // models shared with other side panes. they should be set before setMode(),
+  // otherwise each view creates its own model.
+  void setPlacesModel(PlacesModel* model) {
+    placesModel_ = model;
+  }
+  // the dir tree model is only requested when the dir tree is shown,
+  // so it does not load anything before it's needed.
+  void setDirTreeModelProvider(DirTreeModelProvider provider) {
+    dirTreeModelProvider_ = provider;
+  }
+
   void setMode(Mode mode);
 
   Mode mode() {
@@ -107,6 +125,7 @@ protected Q_SLOTS:
   void onPlacesViewChdirRequested(int type, FmPath* path);
   void onDirTreeViewChdirRequested(int type, FmPath* path);
   void onComboCurrentIndexChanged(int current);
+  void onDirTreeRowsInserted(const QModelIndex& parent, int start, int end);
 
 private:
   void initDirTree();
@@ -119,6 +138,9 @@ private:
   QSize iconSize_;
   Mode mode_;
   bool showHidden_;
+  PlacesModel* placesModel_;
+  DirTreeModel* dirTreeModel_;
+  DirTreeModelProvider dirTreeModelProvider_;
 };
 
 }
@@ -0,0 +1,129 @@
+/*
+
+    Copyright (C) 2013  Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+
+#include "trace.h"
+#include <QVector>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QFile>
+#include <glib.h>
+#include <unistd.h>
+
+namespace Fm {
+
+struct TraceEvent {
+  const char* name;
+  char phase; // 'X' for complete events, 'i' for instant events
+  int tid;
+  qint64 begin;
+  qint64 duration;
+};
+
+static QMutex traceLock;
+static QVector<TraceEvent> traceEvents;
+static QHash<Qt::HANDLE, int> traceThreads; // small ids are easier to read in the viewer
+
+static void addEvent(const char* name, char phase, qint64 begin, qint64 duration) {
+  QMutexLocker locker(&traceLock);
+  Qt::HANDLE thread = QThread::currentThreadId();
+  QHash<Qt::HANDLE, int>::const_iterator it = traceThreads.constFind(thread);
+  if(it == traceThreads.constEnd())
+    it = traceThreads.insert(thread, traceThreads.size() + 1);
+  TraceEvent event;
+  event.name = name;
+  event.phase = phase;
+  event.tid = it.value();
+  event.begin = begin;
+  event.duration = duration;
+  traceEvents.append(event);
+}
+
+static QByteArray jsonString(const char* str) {
+  QByteArray result = "\"";
+  for(const char* p = str; *p; ++p) {
+    if(*p == '"' || *p == '\\')
+      result += '\\';
+    result += *p;
+  }
+  result += '"';
+  return result;
+}
+
+QAtomicInt Trace::enabled_(0);
+
+void Trace::start() {
+  QMutexLocker locker(&traceLock);
+  traceEvents.reserve(256);
+  enabled_.fetchAndStoreOrdered(1);
+}
+
+void Trace::stop() {
+  QMutexLocker locker(&traceLock);
+  enabled_.fetchAndStoreOrdered(0);
+  traceEvents.clear();
+  traceThreads.clear();
+}
+
+qint64 Trace::now() {
+  return g_get_monotonic_time();
+}
+
+void Trace::addComplete(const char* name, qint64 begin, qint64 end) {
+  if(isEnabled())
+    addEvent(name, 'X', begin, end - begin);
+}
+
+void Trace::addInstant(const char* name) {
+  if(isEnabled())
+    addEvent(name, 'i', now(), 0);
+}
+
+bool Trace::save(const QString& fileName) {
+  QByteArray pid = QByteArray::number(getpid());
+  QByteArray data = "{\"traceEvents\":[\n";
+  {
+    QMutexLocker locker(&traceLock);
+    for(int i = 0; i < traceEvents.size(); ++i) {
+      const TraceEvent& event = traceEvents.at(i);
+      if(i > 0)
+        data += ",\n";
+      data += "{\"name\":" + jsonString(event.name);
+      data += ",\"cat\":\"startup\",\"ph\":\"";
+      data += event.phase;
+      data += "\",\"ts\":" + QByteArray::number(event.begin);
+      if(event.phase == 'X')
+        data += ",\"dur\":" + QByteArray::number(event.duration);
+      else
+        data += ",\"s\":\"p\""; // show instant events across the whole process
+      data += ",\"pid\":" + pid + ",\"tid\":" + QByteArray::number(event.tid) + "}";
+    }
+  }
+  data += "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+  QFile file(fileName);
+  if(!file.open(QIODevice::WriteOnly|QIODevice::Truncate))
+    return false;
+  return file.write(data) == data.size();
+}
+
+}
@@ -0,0 +1,85 @@
+/*
+
+    Copyright (C) 2013  Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+
+#ifndef FM_TRACE_H
+#define FM_TRACE_H
+
+#include "libfmqtglobals.h"
+#include <QString>
+#include <QAtomicInt>
+
+namespace Fm {
+
+// A lightweight tracer used to find out where the time goes, mainly during
+// the startup. It does nothing until start() is called. The recorded events
+// are saved in the Chrome trace event format, so they can be viewed with
+// chrome://tracing and compared among builds.
+class LIBFM_QT_API Trace {
+public:
+  static void start();
+  // free the recorded events and stop recording
+  static void stop();
+
+  static bool isEnabled() {
+    return enabled_.fetchAndAddOrdered(0) != 0;
+  }
+
+  // monotonic time in microseconds
+  static qint64 now();
+
+  // the names should be string literals since only the pointers are kept
+  static void addComplete(const char* name, qint64 begin, qint64 end);
+  static void addInstant(const char* name);
+
+  static bool save(const QString& fileName);
+
+private:
+  static QAtomicInt enabled_; // read by worker threads, too
+};
+
+// Records the time spent in a scope when tracing is enabled.
+class LIBFM_QT_API TraceScope {
+public:
+  explicit TraceScope(const char* name):
+    name_(Trace::isEnabled() ? name : NULL),
+    begin_(name_ ? Trace::now() : 0) {
+  }
+
+  ~TraceScope() {
+    end();
+  }
+
+  // end the event before leaving the scope
+  void end() {
+    if(name_) {
+      Trace::addComplete(name_, begin_, Trace::now());
+      name_ = NULL;
+    }
+  }
+
+private:
+  const char* name_;
+  qint64 begin_;
+};
+
+}
+
+#endif // FM_TRACE_H
@@ -32,17 +32,28 @@
 #include <QFile>
 #include <QMessageBox>
 #include <gio/gio.h>
+#include <limits.h>
 
 #include "applicationadaptor.h"
 #include "preferencesdialog.h"
 #include "desktoppreferencesdialog.h"
 #include "mountoperation.h"
 #include "autorundialog.h"
+#include "findfilesdialog.h"
 #include "launcher.h"
+#include "fileoperation.h"
+#include "fileoperationjournal.h"
+#include "fileindex.h"
+#include "trace.h"
+#include "placesmodel.h"
+#include "dirtreemodel.h"
+#include "cachedfoldermodel.h"
 
 using namespace PCManFM;
 static const char* serviceName = "org.pcmanfm.PCManFM";
 static const char* ifaceName = "org.pcmanfm.Application";
+// max time in ms to wait for the first folder before saving the startup trace
+static const int STARTUP_TRACE_TIMEOUT = 10000;
 
 Application::Application(int& argc, char** argv):
   QApplication(argc, argv),
@@ -54,6 +65,9 @@ Application::Application(int& argc, char** argv):
   enableDesktopManager_(false),
   preferencesDialog_(),
   volumeMonitor_(NULL),
+  fileIndex_(NULL),
+  placesModel_(NULL),
+  dirTreeModel_(NULL),
   editBookmarksialog_() {
 
   argc_ = argc;
@@ -87,6 +101,10 @@ Application::Application(int& argc, char** argv):
 }
 
 Application::~Application() {
+  delete fileIndex_; // the index is saved if it's changed
+  // the models use libfm, so they're freed before libfm is finalized
+  delete placesModel_;
+  delete dirTreeModel_;
   if(volumeMonitor_) {
     g_signal_handlers_disconnect_by_func(volumeMonitor_, gpointer(onVolumeAdded), this);
     g_object_unref(volumeMonitor_);
@@ -107,6 +125,7 @@ struct FakeTr {
 };
 
 bool Application::parseCommandLineArgs() {
+  Fm::TraceScope trace("Application::parseCommandLineArgs");
   bool keepRunning = false;
 
   // It's really a shame that the great Qt library does not come
@@ -127,6 +146,7 @@ bool Application::parseCommandLineArgs() {
   char* show_pref = NULL;
   gboolean new_window = FALSE;
   gboolean find_files = FALSE;
+  char* startup_trace = NULL;
   char** file_names = NULL;
   {
     FakeTr tr; // a functor used to override QObject::tr().
@@ -136,6 +156,7 @@ bool Application::parseCommandLineArgs() {
       /* options only acceptable by first pcmanfm instance. These options are not passed through IPC */
       {"profile", 'p', 0, G_OPTION_ARG_STRING, &profile, tr("Name of configuration profile"), tr("PROFILE") },
       {"daemon-mode", 'd', 0, G_OPTION_ARG_NONE, &daemon_mode, tr("Run PCManFM as a daemon"), NULL },
+      {"startup-trace", '\0', 0, G_OPTION_ARG_FILENAME, &startup_trace, tr("Write the time spent in the startup to FILE in Chrome trace event format"), tr("FILE") },
       // options that are acceptable for every instance of pcmanfm and will be passed through IPC.
       {"quit", 'p', 0, G_OPTION_ARG_NONE, &ask_quit, tr("Quit PCManFM"), NULL},
       {"desktop", '\0', 0, G_OPTION_ARG_NONE, &desktop, tr("Launch desktop manager"), NULL },
@@ -171,9 +192,18 @@ bool Application::parseCommandLineArgs() {
       daemonMode_ = true;
     if(profile)
       profileName_ = profile;
+    if(startup_trace)
+      startupTraceFile_ = QString::fromLocal8Bit(startup_trace);
 
     // load settings
     settings_.load(profileName_);
+    updateFolderModelCacheFromSettings();
+    // interrupted file operations are resumed from the journals kept here
+    Fm::FileOperationJournal::setJournalDir(settings_.profileDir(profileName_) + "/journal");
+
+    // the daemon keeps an index of file names to answer file searches quickly
+    if(daemonMode_ && settings_.fileIndex())
+      startFileIndex();
 
     // desktop icon management
     if(desktop) {
@@ -286,6 +316,7 @@ bool Application::parseCommandLineArgs() {
 }
 
 void Application::init() {
+  Fm::TraceScope trace("Application::init");
 
   // install the translations built-into Qt itself
   qtTranslator.load("qt_" + QLocale::system().name(), QLibraryInfo::location(QLibraryInfo::TranslationsPath));
@@ -315,13 +346,73 @@ int Application::exec() {
   // we get volume-added signals for all of the volumes. This is not what we want.
   // So, we wait for 3 seconds here to let it finish device discovery.
   QTimer::singleShot(3000, this, SLOT(initVolumeManager()));
+  QTimer::singleShot(0, this, SLOT(resumeFileOperations()));
+  // the startup is done when the first folder is loaded, see folderLoaded().
+  // save the trace anyway if it never happens, like when only the desktop is managed.
+  if(!startupTraceFile_.isEmpty())
+    QTimer::singleShot(STARTUP_TRACE_TIMEOUT, this, SLOT(saveStartupTrace()));
+  else
+    Fm::Trace::stop();
 
   return QCoreApplication::exec();
 }
 
+void Application::folderLoaded() {
+  // wait for an idle pass, so the work queued after loading the folder is recorded, too.
+  if(!startupTraceFile_.isEmpty())
+    QTimer::singleShot(0, this, SLOT(saveStartupTrace()));
+}
+
+void Application::saveStartupTrace() {
+  if(startupTraceFile_.isEmpty()) // already saved
+    return;
+  Fm::Trace::addInstant("startup finished");
+  if(!Fm::Trace::save(startupTraceFile_))
+    qWarning("failed to write the startup trace to %s", startupTraceFile_.toLocal8Bit().constData());
+  Fm::Trace::stop();
+  startupTraceFile_.clear();
+}
+
+// offer to resume the file operations interrupted by a crash or the end of the session
+void Application::resumeFileOperations() {
+  QList<Fm::FileOperationJournal*> journals;
+  QString details;
+  Q_FOREACH(const QString& fileName, Fm::FileOperationJournal::interruptedJournals()) {
+    Fm::FileOperationJournal* journal = Fm::FileOperationJournal::load(fileName);
+    if(!journal)
+      continue;
+    journals.append(journal);
+    int n = journal->srcPaths().size();
+    QString dest = QString::fromLocal8Bit(journal->destPath());
+    if(journal->type() == FM_FILE_OP_MOVE)
+      details += tr("Move %n file(s) to %1", "", n).arg(dest);
+    else
+      details += tr("Copy %n file(s) to %1", "", n).arg(dest);
+    details += '\n';
+  }
+  if(journals.isEmpty())
+    return;
+
+  QMessageBox box(QMessageBox::Question, tr("Resume File Operations"),
+                  tr("Some file operations were interrupted last time. Do you want to resume them?"),
+                  QMessageBox::Yes|QMessageBox::No);
+  box.setDetailedText(details);
+  bool resume = (box.exec() == QMessageBox::Yes);
+  Q_FOREACH(Fm::FileOperationJournal* journal, journals) {
+    if(resume)
+      Fm::FileOperation::resume(journal);
+    else {
+      journal->remove();
+      delete journal;
+    }
+  }
+}
+
 void Application::onAboutToQuit() {
   qDebug("aboutToQuit");
   settings_.save();
+  if(fileIndex_)
+    fileIndex_->save();
 }
 
 void Application::commitData(QSessionManager& manager) {
@@ -385,9 +476,22 @@ void Application::desktopPrefrences(QString page) {
   desktopPreferencesDialog_.data()->activateWindow();
 }
 
+void Application::startFileIndex() {
+  QString fileName = QFile::decodeName(g_get_user_cache_dir()) + "/pcmanfm-qt/" + profileName_ + "/file-index";
+  fileIndex_ = new Fm::FileIndex(fileName);
+  fileIndex_->setRoots(settings_.fileIndexRoots());
+  // the setting is in minutes. don't overflow an int with huge values.
+  qint64 seconds = qint64(settings_.fileIndexRescanInterval()) * 60;
+  fileIndex_->setRescanInterval(int(qMin(seconds, qint64(INT_MAX))));
+  fileIndex_->start();
+  Fm::FileIndex::setDefaultIndex(fileIndex_);
+}
+
 void Application::findFiles(QStringList paths) {
-  // TODO: add a file searching utility here.
-  qDebug("findFiles");
+  FindFilesDialog* dlg = new FindFilesDialog(paths);
+  dlg->show();
+  dlg->raise();
+  dlg->activateWindow();
 }
 
 void Application::launchFiles(QStringList paths, bool inNewWindow) {
@@ -407,6 +511,29 @@ void Application::openFolders(FmFileInfoList* files) {
   Launcher(NULL).launchFiles(NULL, files);
 }
 
+// the devices, the trash, and the bookmarks are monitored only once for all windows
+Fm::PlacesModel* Application::placesModel() {
+  if(!placesModel_)
+    placesModel_ = new Fm::PlacesModel();
+  return placesModel_;
+}
+
+Fm::DirTreeModel* Application::dirTreeModel() {
+  if(!dirTreeModel_) {
+    dirTreeModel_ = new Fm::DirTreeModel(NULL);
+    FmPathList* paths = fm_path_list_new();
+    fm_path_list_push_tail(paths, fm_path_get_home());
+    fm_path_list_push_tail(paths, fm_path_get_root());
+    dirTreeModel_->addRoots(paths);
+    fm_path_list_unref(paths);
+  }
+  return dirTreeModel_;
+}
+
+Fm::DirTreeModel* Application::sharedDirTreeModel() {
+  return static_cast<Application*>(qApp)->dirTreeModel();
+}
+
 void Application::openFolderInTerminal(FmPath* path) {
   if(!settings_.terminal().isEmpty()) {
     char* cwd_str;
@@ -539,6 +666,13 @@ void Application::updateFromSettings() {
   }
   if(desktopManagerEnabled())
     updateDesktopsFromSettings();
+  updateFolderModelCacheFromSettings();
+}
+
+// the folder models kept after their folders are closed
+void Application::updateFolderModelCacheFromSettings() {
+  Fm::CachedFolderModel::setMaxRetainedModels(settings_.retainedFolderModels());
+  Fm::CachedFolderModel::setMaxRetainedMemory(qint64(settings_.retainedFolderModelsMemory()) * 1024 * 1024);
 }
 
 void Application::updateDesktopsFromSettings() {
@@ -30,6 +30,12 @@
 #include <QTranslator>
 #include <gio/gio.h>
 
+namespace Fm {
+  class FileIndex;
+  class PlacesModel;
+  class DirTreeModel;
+};
+
 namespace PCManFM {
 
 class DesktopWindow;
@@ -47,6 +53,9 @@ public:
   void init();
   int exec();
 
+  // called when a folder is loaded. the startup trace is saved after the first one.
+  void folderLoaded();
+
   Settings& settings() {
     return settings_;
   }
@@ -70,6 +79,13 @@ public:
 
   void updateFromSettings();
   void updateDesktopsFromSettings();
+  void updateFolderModelCacheFromSettings();
+
+  // models shared by the side panes of all windows
+  Fm::PlacesModel* placesModel();
+  Fm::DirTreeModel* dirTreeModel();
+  // for Fm::SidePane::setDirTreeModelProvider()
+  static Fm::DirTreeModel* sharedDirTreeModel();
 
   void openFolderInTerminal(FmPath* path);
   void openFolders(FmFileInfoList* files);
@@ -87,12 +103,15 @@ protected Q_SLOTS:
   void onWorkAreaResized(int num);
   void onScreenCountChanged(int newCount);
   void initVolumeManager();
+  void resumeFileOperations();
+  void saveStartupTrace();
  
 protected:
   virtual void commitData(QSessionManager & manager);
   bool parseCommandLineArgs();
   DesktopWindow* createDesktopWindow(int screenNum);
   bool autoMountVolume(GVolume* volume, bool interactive = true);
+  void startFileIndex();
   
   static void onVolumeAdded(GVolumeMonitor* monitor, GVolume* volume, Application* pThis);
 
@@ -110,6 +129,10 @@ private:
   QTranslator translator;
   QTranslator qtTranslator;
   GVolumeMonitor* volumeMonitor_;
+  Fm::FileIndex* fileIndex_; // only used in daemon mode
+  Fm::PlacesModel* placesModel_;
+  Fm::DirTreeModel* dirTreeModel_;
+  QString startupTraceFile_;
   int argc_;
   char** argv_;
 };
@@ -0,0 +1,160 @@
+/*
+
+    Copyright (C) 2013  Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+
+#include "findfilesdialog.h"
+#include "filesearch.h"
+#include "application.h"
+#include "mainwindow.h"
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QMessageBox>
+
+using namespace PCManFM;
+
+FindFilesDialog::FindFilesDialog(QStringList paths, QWidget* parent, Qt::WindowFlags f):
+  QDialog(parent, f) {
+
+  setAttribute(Qt::WA_DeleteOnClose);
+  ui.setupUi(this);
+
+  if(paths.isEmpty())
+    paths.append(QDir::homePath());
+  Q_FOREACH(const QString& path, paths)
+    ui.listWidget->addItem(QFileInfo(path).absoluteFilePath());
+  ui.checkBox_3->setChecked(true); // search in sub dirs by default
+
+  // units of the size limits
+  QStringList units;
+  units << tr("Bytes") << tr("KiB") << tr("MiB") << tr("GiB");
+  ui.comboBox->addItems(units);
+  ui.comboBox_2->addItems(units);
+  ui.comboBox->setCurrentIndex(2);
+  ui.comboBox_2->setCurrentIndex(2);
+  ui.spinBox->setRange(0, 1023);
+  ui.spinBox_2->setRange(0, 1023);
+
+  QDateTime now = QDateTime::currentDateTime();
+  ui.dateTimeEdit->setDateTime(now);
+  ui.dateTimeEdit_2->setDateTime(now.addDays(-7));
+
+  connect(ui.pushButton, SIGNAL(clicked(bool)), SLOT(onAddPath()));
+  connect(ui.pushButton_2, SIGNAL(clicked(bool)), SLOT(onRemovePath()));
+}
+
+FindFilesDialog::~FindFilesDialog() {
+}
+
+void FindFilesDialog::onAddPath() {
+  QString dir = QFileDialog::getExistingDirectory(this, tr("Select a folder"));
+  if(!dir.isEmpty())
+    ui.listWidget->addItem(dir);
+}
+
+void FindFilesDialog::onRemovePath() {
+  qDeleteAll(ui.listWidget->selectedItems());
+}
+
+bool FindFilesDialog::setupSearch(Fm::FileSearch& search) {
+  QStringList paths;
+  for(int i = 0; i < ui.listWidget->count(); ++i)
+    paths.append(ui.listWidget->item(i)->text());
+  if(paths.isEmpty()) {
+    QMessageBox::critical(this, tr("Error"), tr("Please add at least one folder to search in."));
+    return false;
+  }
+  search.setSearchPaths(paths);
+  search.setRecursive(ui.checkBox_3->isChecked());
+  search.setShowHidden(ui.checkBox_4->isChecked());
+
+  QString pattern = ui.lineEdit->text();
+  bool caseInsensitive = ui.checkBox->isChecked();
+  if(ui.checkBox_2->isChecked() && !QRegExp(pattern).isValid()) {
+    QMessageBox::critical(this, tr("Error"), tr("The file name pattern is not a valid regular expression."));
+    return false;
+  }
+  search.setNamePattern(pattern);
+  search.setNameCaseInsensitive(caseInsensitive);
+  search.setNameRegExp(ui.checkBox_2->isChecked());
+
+  QStringList mimeTypes;
+  if(ui.checkBox_5->isChecked())
+    mimeTypes << "text/*";
+  if(ui.checkBox_6->isChecked())
+    mimeTypes << "image/*";
+  if(ui.checkBox_7->isChecked())
+    mimeTypes << "audio/*";
+  if(ui.checkBox_8->isChecked())
+    mimeTypes << "video/*";
+  if(ui.checkBox_9->isChecked()) {
+    mimeTypes << "application/pdf"
+              << "application/postscript"
+              << "application/rtf"
+              << "application/msword"
+              << "application/vnd.ms-*"
+              << "application/vnd.oasis.opendocument.*"
+              << "application/vnd.openxmlformats-officedocument.*"
+              << "application/x-abiword";
+  }
+  search.setMimeTypes(mimeTypes);
+
+  QString content = ui.lineEdit_2->text();
+  if(!content.isEmpty()) {
+    if(ui.checkBox_11->isChecked() && !QRegExp(content).isValid()) {
+      QMessageBox::critical(this, tr("Error"), tr("The file content pattern is not a valid regular expression."));
+      return false;
+    }
+    search.setContentPattern(content);
+    search.setContentCaseInsensitive(ui.checkBox_10->isChecked());
+    search.setContentRegExp(ui.checkBox_11->isChecked());
+  }
+
+  if(ui.checkBox_12->isChecked())
+    search.setMinSize(qint64(ui.spinBox->value()) << (10 * ui.comboBox->currentIndex()));
+  if(ui.checkBox_13->isChecked())
+    search.setMaxSize(qint64(ui.spinBox_2->value()) << (10 * ui.comboBox_2->currentIndex()));
+  if(ui.checkBox_14->isChecked()) // earlier than
+    search.setMaxMtime(ui.dateTimeEdit->dateTime().toTime_t());
+  if(ui.checkBox_15->isChecked()) // later than
+    search.setMinMtime(ui.dateTimeEdit_2->dateTime().toTime_t());
+  return true;
+}
+
+FmPath* FindFilesDialog::searchPath() {
+  Fm::FileSearch search;
+  if(!setupSearch(search))
+    return NULL;
+  return search.path();
+}
+
+void FindFilesDialog::accept() {
+  FmPath* path = searchPath();
+  if(!path) // keep the dialog open to correct the errors
+    return;
+  // show the results in a new window
+  Application* app = static_cast<Application*>(qApp);
+  MainWindow* win = new MainWindow(path);
+  fm_path_unref(path);
+  win->resize(app->settings().windowWidth(), app->settings().windowHeight());
+  win->show();
+  QDialog::accept();
+}
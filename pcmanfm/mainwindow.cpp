@@ -30,6 +30,7 @@
 #include <QShortcut>
 #include <QKeySequence>
 #include <QDebug>
+#include <QTimer>
 
 #include "tabpage.h"
 #include "filelauncher.h"
@@ -41,6 +42,7 @@
 #include "pathedit.h"
 #include "ui_about.h"
 #include "application.h"
+#include "trace.h"
 
 // #include "qmodeltest/modeltest.h"
 
@@ -50,7 +52,9 @@ namespace PCManFM {
 
 MainWindow::MainWindow(FmPath* path):
   QMainWindow(),
+  bookmarks(NULL),
   fileLauncher_(this) {
+  Fm::TraceScope trace("MainWindow::MainWindow");
 
   Settings& settings = static_cast<Application*>(qApp)->settings();
   setAttribute(Qt::WA_DeleteOnClose);
@@ -80,9 +84,8 @@ MainWindow::MainWindow(FmPath* path):
   connect(ui.tabBar, SIGNAL(tabCloseRequested(int)), SLOT(onTabBarCloseRequested(int)));
   connect(ui.stackedWidget, SIGNAL(widgetRemoved(int)), SLOT(onStackedWidgetWidgetRemoved(int)));
 
-  // side pane
+  // side pane. its view is created in lazyInit().
   ui.sidePane->setIconSize(QSize(settings.sidePaneIconSize(), settings.sidePaneIconSize()));
-  ui.sidePane->setMode(Fm::SidePane::ModePlaces);
   connect(ui.sidePane, SIGNAL(chdirRequested(int, FmPath*)), SLOT(onSidePaneChdirRequested(int, FmPath*)));
 
   // path bar
@@ -101,10 +104,8 @@ MainWindow::MainWindow(FmPath* path):
   sizes.append(300);
   ui.splitter->setSizes(sizes);
 
-  // load bookmark menu
-  bookmarks = fm_bookmarks_dup();
-  g_signal_connect(bookmarks, "changed", G_CALLBACK(onBookmarksChanged), this);
-  loadBookmarksMenu();
+  // the bookmarks are loaded when the menu is opened for the first time
+  connect(ui.menu_Bookmarks, SIGNAL(aboutToShow()), SLOT(loadBookmarks()));
 
   // Fix the menu groups which is not done by Qt designer
   // To my suprise, this was supported in Qt designer 3 :-(
@@ -128,6 +129,30 @@ MainWindow::MainWindow(FmPath* path):
   group->addAction(ui.actionAscending);
   group->addAction(ui.actionDescending);
 
+  if(path)
+    addTab(path);
+
+  // show the window and the folder first, and then create the rest
+  QTimer::singleShot(0, this, SLOT(lazyInit()));
+}
+
+MainWindow::~MainWindow() {
+  if(bookmarks) {
+    g_signal_handlers_disconnect_by_func(bookmarks, (gpointer)onBookmarksChanged, this);
+    g_object_unref(bookmarks);
+  }
+}
+
+// create the parts of the window which are not needed for the first paint
+void MainWindow::lazyInit() {
+  Fm::TraceScope trace("MainWindow::lazyInit");
+
+  // all windows share the models of the side pane
+  Application* app = static_cast<Application*>(qApp);
+  ui.sidePane->setPlacesModel(app->placesModel());
+  ui.sidePane->setDirTreeModelProvider(&Application::sharedDirTreeModel);
+  ui.sidePane->setMode(Fm::SidePane::ModePlaces);
+
   // create shortcuts
   QShortcut* shortcut = new QShortcut(Qt::CTRL + Qt::Key_L, this);
   connect(shortcut, SIGNAL(activated()), pathEntry, SLOT(setFocus()));
@@ -146,14 +171,6 @@ MainWindow::MainWindow(FmPath* path):
     shortcut = new QShortcut(QKeySequence(Qt::CTRL + Qt::Key_0 + i), this);
     connect(shortcut, SIGNAL(activated()), SLOT(onShortcutJumpToTab()));
   }
-
-  if(path)
-    addTab(path);
-}
-
-MainWindow::~MainWindow() {
-  if(bookmarks)
-    g_object_unref(bookmarks);
 }
 
 void MainWindow::chdir(FmPath* path) {
@@ -354,6 +371,7 @@ void MainWindow::on_actionAddToBookmarks_triggered() {
     FmPath* cwd = page->path();
 
     if(cwd) {
+      loadBookmarks();
       char* dispName = fm_path_display_basename(cwd);
       fm_bookmarks_insert(bookmarks, cwd, dispName, -1);
       g_free(dispName);
@@ -585,6 +603,14 @@ void MainWindow::onSidePaneChdirRequested(int type, FmPath* path) {
   chdir(path);
 }
 
+void MainWindow::loadBookmarks() {
+  if(bookmarks) // already loaded
+    return;
+  bookmarks = fm_bookmarks_dup();
+  g_signal_connect(bookmarks, "changed", G_CALLBACK(onBookmarksChanged), this);
+  loadBookmarksMenu();
+}
+
 void MainWindow::loadBookmarksMenu() {
   GList* l = fm_bookmarks_get_all(bookmarks);
   QAction* before = ui.actionAddToBookmarks;
@@ -129,6 +129,9 @@ protected Q_SLOTS:
   void onSidePaneChdirRequested(int type, FmPath* path);
 
   void onBackForwardContextMenu(QPoint pos);
+
+  void lazyInit();
+  void loadBookmarks();
   
 protected:
   // void changeEvent( QEvent * event);
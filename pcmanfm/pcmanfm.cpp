@@ -1,9 +1,22 @@
 #include <libfm/fm.h>
 #include "application.h"
 #include "libfmqt.h"
+#include "trace.h"
+#include <string.h>
 
 int main(int argc, char** argv) {
+  // tracing is started before anything else, so the whole startup is recorded.
+  // the option is parsed again later with the others to get the file name.
+  for(int i = 1; i < argc; ++i) {
+    if(strcmp(argv[i], "--startup-trace") == 0 || strncmp(argv[i], "--startup-trace=", 16) == 0) {
+      Fm::Trace::start();
+      break;
+    }
+  }
+
+  Fm::TraceScope trace("Application::Application");
   PCManFM::Application app(argc, argv);
+  trace.end();
   app.init();
   return app.exec();
 }
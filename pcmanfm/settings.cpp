@@ -25,6 +25,7 @@
 #include <QSettings>
 #include <QApplication>
 #include "desktopwindow.h"
+#include "trace.h"
 // #include <QDesktopServices>
 
 using namespace PCManFM;
@@ -84,10 +85,15 @@ Settings::Settings():
   showThumbnails_(true),
   archiver_(),
   siUnit_(false),
+  fileIndex_(false),
+  fileIndexRoots_(),
+  fileIndexRescanInterval_(60),
   bigIconSize_(48),
   smallIconSize_(24),
   sidePaneIconSize_(24),
-  thumbnailIconSize_(128) {
+  thumbnailIconSize_(128),
+  retainedFolderModels_(8),
+  retainedFolderModelsMemory_(64) {
 }
 
 Settings::~Settings() {
@@ -119,6 +125,7 @@ QString Settings::profileDir(QString profile, bool useFallback) {
 }
 
 bool Settings::load(QString profile) {
+  Fm::TraceScope trace("Settings::load");
   profileName_ = profile;
   QString fileName = profileDir(profile, true) % "/settings.conf";
   return loadFile(fileName);
@@ -187,6 +194,9 @@ bool Settings::loadFile(QString filePath) {
   showHidden_ = settings.value("ShowHidden", false).toBool();
   sortOrder_ = sortOrderFromString(settings.value("SortOrder").toString());
   sortColumn_ = sortColumnFromString(settings.value("SortColumn").toString());
+  // number and memory (in MiB) of folder models kept after their folders are closed
+  retainedFolderModels_ = settings.value("RetainedFolderModels", 8).toInt();
+  retainedFolderModelsMemory_ = settings.value("RetainedFolderModelsMemory", 64).toInt();
 
   // override config in libfm's FmConfig
   bigIconSize_ = settings.value("BigIconSize", 48).toInt();
@@ -203,6 +213,12 @@ bool Settings::loadFile(QString filePath) {
   splitterPos_ = settings.value("SplitterPos", 150).toInt();
   sidePaneMode_ = sidePaneModeFromString(settings.value("SidePaneMode").toString());
   settings.endGroup();
+
+  settings.beginGroup("FileIndex");
+  fileIndex_ = settings.value("Enabled", false).toBool();
+  fileIndexRoots_ = settings.value("Roots", QStringList() << QDir::homePath()).toStringList();
+  fileIndexRescanInterval_ = settings.value("RescanInterval", 60).toInt();
+  settings.endGroup();
   return true;
 }
 
@@ -256,6 +272,8 @@ bool Settings::saveFile(QString filePath) {
   settings.setValue("ShowHidden", showHidden_);
   settings.setValue("SortOrder", sortOrderToString(sortOrder_));
   settings.setValue("SortColumn", sortColumnToString(sortColumn_));
+  settings.setValue("RetainedFolderModels", retainedFolderModels_);
+  settings.setValue("RetainedFolderModelsMemory", retainedFolderModelsMemory_);
 
   // override config in libfm's FmConfig
   settings.setValue("BigIconSize", bigIconSize_);
@@ -272,6 +290,12 @@ bool Settings::saveFile(QString filePath) {
   settings.setValue("SplitterPos", splitterPos_);
   // settings.setValue("SidePaneMode", sidePaneModeToString(sidePaneMode_));
   settings.endGroup();
+
+  settings.beginGroup("FileIndex");
+  settings.setValue("Enabled", fileIndex_);
+  settings.setValue("Roots", fileIndexRoots_);
+  settings.setValue("RescanInterval", fileIndexRescanInterval_);
+  settings.endGroup();
   return true;
 }
 
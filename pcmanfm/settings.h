@@ -22,6 +22,7 @@
 #define PCMANFM_SETTINGS_H
 
 #include <QObject>
+#include <QStringList>
 #include <libfm/fm.h>
 #include "folderview.h"
 #include "foldermodel.h"
@@ -354,6 +355,49 @@ public:
     thumbnailIconSize_ = thumbnailIconSize;
   }
 
+  int retainedFolderModels() {
+    return retainedFolderModels_;
+  }
+
+  void setRetainedFolderModels(int max) {
+    retainedFolderModels_ = max;
+  }
+
+  // in MiB
+  int retainedFolderModelsMemory() {
+    return retainedFolderModelsMemory_;
+  }
+
+  void setRetainedFolderModelsMemory(int size) {
+    retainedFolderModelsMemory_ = size;
+  }
+
+  // the file name index is only kept in daemon mode
+  bool fileIndex() {
+    return fileIndex_;
+  }
+
+  void setFileIndex(bool enabled) {
+    fileIndex_ = enabled;
+  }
+
+  QStringList fileIndexRoots() {
+    return fileIndexRoots_;
+  }
+
+  void setFileIndexRoots(const QStringList& roots) {
+    fileIndexRoots_ = roots;
+  }
+
+  // in minutes
+  int fileIndexRescanInterval() {
+    return fileIndexRescanInterval_;
+  }
+
+  void setFileIndexRescanInterval(int minutes) {
+    fileIndexRescanInterval_ = minutes;
+  }
+
   bool siUnit() {
     return siUnit_;
   }
@@ -411,10 +455,16 @@ private:
   QString archiver_;
   bool siUnit_;
 
+  bool fileIndex_;
+  QStringList fileIndexRoots_;
+  int fileIndexRescanInterval_;
+
   int bigIconSize_;
   int smallIconSize_;
   int sidePaneIconSize_;
   int thumbnailIconSize_;
+  int retainedFolderModels_;
+  int retainedFolderModelsMemory_;
 };
 
 }
@@ -30,17 +30,62 @@
 #include "settings.h"
 #include "application.h"
 #include "cachedfoldermodel.h"
+#include "searchfoldermodel.h"
+#include "filesearch.h"
+#include "trace.h"
 #include <QTimer>
+#include <QSet>
+#include <QItemSelection>
+#include <QKeyEvent>
+#include <QHash>
 
 using namespace Fm;
 
 namespace PCManFM {
 
+// filters the files by the text typed in the filter bar of a tab.
+// the lower case names are cached, so only a string search is done per file
+// when the text is changed, even for folders with a huge number of files.
+class NameFilter : public Fm::ProxyFolderModelFilter {
+public:
+  virtual ~NameFilter() {
+    QHash<FmFileInfo*, QString>::const_iterator it;
+    for(it = names_.constBegin(); it != names_.constEnd(); ++it)
+      fm_file_info_unref(it.key());
+  }
+
+  // returns true if the new pattern accepts fewer files than the old one
+  bool setPattern(const QString& pattern) {
+    QString folded = pattern.toLower();
+    bool narrowing = folded.contains(pattern_);
+    pattern_ = folded;
+    return narrowing;
+  }
+
+  virtual bool filterAcceptsRow(const Fm::ProxyFolderModel* model, FmFileInfo* info) const {
+    QHash<FmFileInfo*, QString>::const_iterator it = names_.constFind(info);
+    if(it == names_.constEnd()) {
+      // the info is referenced, so its address is not reused by another file
+      QString name = QString::fromUtf8(fm_file_info_get_disp_name(info)).toLower();
+      it = names_.insert(fm_file_info_ref(info), name);
+    }
+    return it.value().contains(pattern_);
+  }
+
+private:
+  QString pattern_;
+  mutable QHash<FmFileInfo*, QString> names_;
+};
+
 TabPage::TabPage(FmPath* path, QWidget* parent):
   QWidget(parent),
   folder_(NULL),
   folderModel_(NULL),
-  overrideCursor_(false) {
+  searchModel_(NULL),
+  searchPath_(NULL),
+  nameFilter_(NULL),
+  overrideCursor_(false),
+  restoreStatePending_(false) {
 
   Settings& settings = static_cast<Application*>(qApp)->settings();
 
@@ -62,6 +107,15 @@ TabPage::TabPage(FmPath* path, QWidget* parent):
   folderView_->setModel(proxyModel_);
 
   verticalLayout->addWidget(folderView_);
+  folderView_->childView()->installEventFilter(this);
+
+  // typing in the view shows the filter bar
+  filterBar_ = new QLineEdit(this);
+  filterBar_->setPlaceholderText(tr("Filter by name"));
+  filterBar_->installEventFilter(this);
+  filterBar_->hide();
+  connect(filterBar_, SIGNAL(textChanged(QString)), SLOT(onFilterTextChanged(QString)));
+  verticalLayout->addWidget(filterBar_);
 
   chdir(path, true);
 }
@@ -69,8 +123,10 @@ TabPage::TabPage(FmPath* path, QWidget* parent):
 TabPage::~TabPage() {
   qDebug("delete TabPage");
   freeFolder();
+  freeSearch();
   if(proxyModel_)
     delete proxyModel_;
+  delete nameFilter_;
   if(folderModel_)
     folderModel_->unref();
 
@@ -93,6 +149,18 @@ void TabPage::freeFolder() {
   }
 }
 
+void TabPage::freeSearch() {
+  if(searchModel_) {
+    proxyModel_->setSourceModel(NULL);
+    delete searchModel_; // this stops the search
+    searchModel_ = NULL;
+  }
+  if(searchPath_) {
+    fm_path_unref(searchPath_);
+    searchPath_ = NULL;
+  }
+}
+
 /*static*/ void TabPage::onFolderStartLoading(FmFolder* _folder, TabPage* pThis) {
   if(!pThis->overrideCursor_) {
     // FIXME: sometimes FmFolder of libfm generates unpaired "start-loading" and
@@ -123,6 +191,8 @@ void TabPage::freeFolder() {
 }
 
 /*static*/ void TabPage::onFolderFinishLoading(FmFolder* _folder, TabPage* pThis) {
+  Fm::Trace::addInstant("folder loaded");
+  static_cast<Application*>(qApp)->folderLoaded();
 
   // FIXME: is this needed?
   FmFileInfo* fi = fm_folder_get_info(_folder);
@@ -132,36 +202,10 @@ void TabPage::freeFolder() {
   }
 
   fm_folder_query_filesystem_info(_folder); // FIXME: is this needed?
-#if 0
-  FmFolderView* fv = pThis->folder_view;
-  const FmNavHistoryItem* item;
-  GtkScrolledWindow* scroll = GTK_SCROLLED_WINDOW(fv);
-
-  /* Note: most of the time, we delay the creation of the
-   * folder model and do it after the whole folder is loaded.
-   * That is because adding rows into model is much faster when no handlers
-   * are connected to its signals. So we detach the model from folder view
-   * and create the model again when it's fully loaded.
-   * This optimization, however, is not used for FmFolder objects
-   * with incremental loading (search://) */
-  if(fm_folder_view_get_model(fv) == NULL) {
-    /* create a model for the folder and set it to the view */
-    FmFolderModel* model = fm_folder_model_new(folder, app_config->show_hidden);
-    fm_folder_view_set_model(fv, model);
-#if FM_CHECK_VERSION(1, 0, 2)
-    /* since 1.0.2 sorting should be applied on model instead of view */
-    fm_folder_model_set_sort(model, app_config->sort_by,
-                             (app_config->sort_type == GTK_SORT_ASCENDING) ?
-                             FM_SORT_ASCENDING : FM_SORT_DESCENDING);
-#endif
-    g_object_unref(model);
-  }
 
-  /* scroll to recorded position */
-  item = fm_nav_history_get_cur(pThis->nav_history);
-  gtk_adjustment_set_value(gtk_scrolled_window_get_vadjustment(scroll), item->scroll_pos);
-
-#endif
+  // scroll to recorded position and restore the selection
+  if(pThis->restoreStatePending_)
+    pThis->restoreFolderState();
 
   // update status text
   QString& text = pThis->statusText_[StatusTextNormal];
@@ -225,6 +269,12 @@ void TabPage::freeFolder() {
 }
 
 QString TabPage::formatStatusText() {
+  if(proxyModel_ && searchModel_) {
+    int found = proxyModel_->rowCount();
+    if(searchModel_->isSearching())
+      return tr("Searching... %n item(s) found", "", found);
+    return tr("%n item(s) found", "", found);
+  }
   if(proxyModel_ && folder_) {
     FmFileInfoList* files = fm_folder_get_files(folder_);
     int total_files = fm_file_info_list_get_length(files);
@@ -264,6 +314,13 @@ QString TabPage::formatStatusText() {
   Q_EMIT pThis->statusChanged(StatusTextNormal, pThis->statusText_[StatusTextNormal]);
 }
 
+// the models are only forward declared in the header
+Fm::FolderModel* TabPage::folderModel() {
+  if(searchModel_)
+    return static_cast<Fm::FolderModel*>(searchModel_);
+  return static_cast<Fm::FolderModel*>(folderModel_);
+}
+
 QString TabPage::pathName() {
   char* disp_path = fm_path_display_name(path(), TRUE);
   QString ret = QString::fromUtf8(disp_path);
@@ -272,17 +329,15 @@ QString TabPage::pathName() {
 }
 
 void TabPage::chdir(FmPath* newPath, bool addHistory) {
-  if(folder_) {
+  Fm::TraceScope trace("TabPage::chdir");
+  FmPath* curPath = path();
+  if(curPath) {
     // we're already in the specified dir
-    if(fm_path_equal(newPath, fm_folder_get_path(folder_)))
+    if(fm_path_equal(newPath, curPath))
       return;
 
-    if(addHistory) {
-      // store current scroll pos in the browse history
-      BrowseHistoryItem& item = history_.currentItem();
-      QAbstractItemView* childView = folderView_->childView();
-      item.setScrollPos(childView->verticalScrollBar()->value());
-    }
+    if(addHistory) // store current scroll pos and selection in the browse history
+      saveFolderState();
 
     // free the previous model
     if(folderModel_) {
@@ -292,34 +347,47 @@ void TabPage::chdir(FmPath* newPath, bool addHistory) {
     }
 
     freeFolder();
+    freeSearch();
+    closeFilterBar();
   }
 
-  char* disp_name = fm_path_display_basename(newPath);
-  title_ = QString::fromUtf8(disp_name);
-  Q_EMIT titleChanged(title_);
-  g_free(disp_name);
-
-  folder_ = fm_folder_from_path(newPath);
-  g_signal_connect(folder_, "start-loading", G_CALLBACK(onFolderStartLoading), this);
-  g_signal_connect(folder_, "finish-loading", G_CALLBACK(onFolderFinishLoading), this);
-  g_signal_connect(folder_, "error", G_CALLBACK(onFolderError), this);
-  g_signal_connect(folder_, "fs-info", G_CALLBACK(onFolderFsInfo), this);
-  /* destroy the page when the folder is unmounted or deleted. */
-  g_signal_connect(folder_, "removed", G_CALLBACK(onFolderRemoved), this);
-  g_signal_connect(folder_, "unmount", G_CALLBACK(onFolderUnmount), this);
-  g_signal_connect(folder_, "content-changed", G_CALLBACK(onFolderContentChanged), this);
-
-  folderModel_ = CachedFolderModel::modelFromFolder(folder_);
-  proxyModel_->setSourceModel(folderModel_);
-  proxyModel_->sort(Fm::FolderModel::ColumnFileName);
+  // when going back or forward, restore the state stored in the history
+  // after the model is attached and sorted.
+  restoreStatePending_ = !addHistory;
 
-  if(fm_folder_is_loaded(folder_)) {
-    onFolderStartLoading(folder_, this);
-    onFolderFinishLoading(folder_, this);
-    onFolderFsInfo(folder_, this);
+  if(Fm::FileSearch::isSearchPath(newPath)) {
+    title_ = tr("Search Results");
+    Q_EMIT titleChanged(title_);
+    startSearch(newPath);
+  }
+  else {
+    char* disp_name = fm_path_display_basename(newPath);
+    title_ = QString::fromUtf8(disp_name);
+    Q_EMIT titleChanged(title_);
+    g_free(disp_name);
+
+    folder_ = fm_folder_from_path(newPath);
+    g_signal_connect(folder_, "start-loading", G_CALLBACK(onFolderStartLoading), this);
+    g_signal_connect(folder_, "finish-loading", G_CALLBACK(onFolderFinishLoading), this);
+    g_signal_connect(folder_, "error", G_CALLBACK(onFolderError), this);
+    g_signal_connect(folder_, "fs-info", G_CALLBACK(onFolderFsInfo), this);
+    /* destroy the page when the folder is unmounted or deleted. */
+    g_signal_connect(folder_, "removed", G_CALLBACK(onFolderRemoved), this);
+    g_signal_connect(folder_, "unmount", G_CALLBACK(onFolderUnmount), this);
+    g_signal_connect(folder_, "content-changed", G_CALLBACK(onFolderContentChanged), this);
+
+    folderModel_ = CachedFolderModel::modelFromFolder(folder_);
+    proxyModel_->setSourceModel(folderModel_);
+    proxyModel_->sort(Fm::FolderModel::ColumnFileName);
+
+    if(fm_folder_is_loaded(folder_)) {
+      onFolderStartLoading(folder_, this);
+      onFolderFinishLoading(folder_, this);
+      onFolderFsInfo(folder_, this);
+    }
+    else
+      onFolderStartLoading(folder_, this);
   }
-  else
-    onFolderStartLoading(folder_, this);
 
   if(addHistory) {
     // add current path to browse history
@@ -328,6 +396,122 @@ void TabPage::chdir(FmPath* newPath, bool addHistory) {
   }
 }
 
+// show the results of a search:// path. the files are added to the
+// view while the search is running, so no busy cursor is shown.
+void TabPage::startSearch(FmPath* path) {
+  Fm::FileSearch* search = new Fm::FileSearch();
+  search->setPath(path);
+  searchPath_ = fm_path_ref(path);
+  searchModel_ = new Fm::SearchFolderModel(search);
+  connect(searchModel_, SIGNAL(searchFinished()), SLOT(onSearchFinished()));
+  connect(searchModel_, SIGNAL(rowsInserted(QModelIndex, int, int)), SLOT(updateSearchStatus()));
+  proxyModel_->setSourceModel(searchModel_);
+  proxyModel_->sort(Fm::FolderModel::ColumnFileName);
+
+  updateSearchStatus();
+  statusText_[StatusTextFSInfo].clear();
+  Q_EMIT statusChanged(StatusTextFSInfo, QString());
+}
+
+void TabPage::onSearchFinished() {
+  if(restoreStatePending_)
+    restoreFolderState();
+  updateSearchStatus();
+}
+
+void TabPage::updateSearchStatus() {
+  QString& text = statusText_[StatusTextNormal];
+  text = formatStatusText();
+  Q_EMIT statusChanged(StatusTextNormal, text);
+}
+
+void TabPage::reload() {
+  if(folder_)
+    fm_folder_reload(folder_);
+  else if(searchPath_) { // run the search again
+    FmPath* path = fm_path_ref(searchPath_);
+    freeSearch();
+    startSearch(path);
+    fm_path_unref(path);
+  }
+}
+
+// store the scroll position, the current file, and the selected files
+// of the current folder in the browse history
+void TabPage::saveFolderState() {
+  BrowseHistoryItem& item = history_.currentItem();
+  QAbstractItemView* childView = folderView_->childView();
+  item.setScrollPos(childView->verticalScrollBar()->value());
+
+  QString currentFile;
+  FmFileInfo* currentInfo = proxyModel_->fileInfoFromIndex(childView->currentIndex());
+  if(currentInfo)
+    currentFile = QString::fromUtf8(fm_path_get_basename(fm_file_info_get_path(currentInfo)));
+  item.setCurrentFile(currentFile);
+
+  QStringList selectedFiles;
+  FmFileInfoList* files = folderView_->selectedFiles();
+  if(files) {
+    for(GList* l = fm_file_info_list_peek_head_link(files); l; l = l->next) {
+      FmFileInfo* info = FM_FILE_INFO(l->data);
+      selectedFiles.append(QString::fromUtf8(fm_path_get_basename(fm_file_info_get_path(info))));
+    }
+    fm_file_info_list_unref(files);
+  }
+  item.setSelectedFiles(selectedFiles);
+}
+
+// apply the state stored in the browse history to the view.
+// all changes are done with updates disabled and followed by a single
+// layout, so the view is painted only once at the final position.
+void TabPage::restoreFolderState() {
+  restoreStatePending_ = false;
+  const BrowseHistoryItem& item = history_.currentItem();
+  QAbstractItemView* childView = folderView_->childView();
+  QItemSelectionModel* selModel = childView->selectionModel();
+  // QList::toSet() is deprecated in newer Qt 5
+  QSet<QString> selectedFiles;
+  Q_FOREACH(const QString& name, item.selectedFiles())
+    selectedFiles.insert(name);
+  QString currentFile = item.currentFile();
+  QModelIndex currentIndex;
+  QItemSelection selection;
+
+  // find all the rows in one pass and merge adjacent ones into ranges
+  if(!selectedFiles.isEmpty() || !currentFile.isEmpty()) {
+    int n = proxyModel_->rowCount();
+    int first = -1;
+    for(int row = 0; row <= n; ++row) {
+      bool selected = false;
+      if(row < n) {
+        QModelIndex index = proxyModel_->index(row, 0);
+        FmFileInfo* info = proxyModel_->fileInfoFromIndex(index);
+        QString name = QString::fromUtf8(fm_path_get_basename(fm_file_info_get_path(info)));
+        selected = selectedFiles.contains(name);
+        if(!currentFile.isEmpty() && !currentIndex.isValid() && name == currentFile)
+          currentIndex = index;
+      }
+      if(selected) {
+        if(first < 0)
+          first = row;
+      }
+      else if(first >= 0) {
+        selection.select(proxyModel_->index(first, 0), proxyModel_->index(row - 1, 0));
+        first = -1;
+      }
+    }
+  }
+
+  childView->setUpdatesEnabled(false);
+  if(currentIndex.isValid())
+    selModel->setCurrentIndex(currentIndex, QItemSelectionModel::NoUpdate);
+  selModel->select(selection, QItemSelectionModel::ClearAndSelect|QItemSelectionModel::Rows);
+  // lay out the items now so the scroll range is known before setting the position
+  childView->doItemsLayout();
+  childView->verticalScrollBar()->setValue(item.scrollPos());
+  childView->setUpdatesEnabled(true);
+}
+
 void TabPage::selectAll() {
   folderView_->selectAll();
 }
@@ -400,21 +584,24 @@ void TabPage::onSelChanged(int numSel) {
 
 
 void TabPage::backward() {
+  saveFolderState();
   history_.backward();
   chdir(history_.currentPath(), false);
 }
 
 void TabPage::forward() {
+  saveFolderState();
   history_.forward();
   chdir(history_.currentPath(), false);
 }
 
 bool TabPage::canUp() {
-  return (path() != NULL && fm_path_get_parent(path()) != NULL);
+  // search results have no parent folder
+  return (folder_ != NULL && fm_path_get_parent(path()) != NULL);
 }
 
 void TabPage::up() {
-  FmPath* _path = path();
+  FmPath* _path = folder_ ? path() : NULL;
   if(_path) {
     FmPath* parent = fm_path_get_parent(_path);
     if(parent)
@@ -430,4 +617,67 @@ void TabPage::updateFromSettings(Settings& settings) {
   folderView_->updateFromSettings(settings);
 }
 
+void TabPage::onFilterTextChanged(const QString& text) {
+  if(text.isEmpty()) {
+    if(nameFilter_) {
+      proxyModel_->removeFilter(nameFilter_);
+      delete nameFilter_;
+      nameFilter_ = NULL;
+    }
+  }
+  else if(!nameFilter_) {
+    nameFilter_ = new NameFilter();
+    nameFilter_->setPattern(text);
+    proxyModel_->addFilter(nameFilter_);
+  }
+  else {
+    // when more chars are typed, only the files shown now are checked again
+    bool narrowing = nameFilter_->setPattern(text);
+    proxyModel_->updateFilters(narrowing);
+  }
+}
+
+void TabPage::closeFilterBar() {
+  filterBar_->clear(); // this removes the filter
+  filterBar_->hide();
+}
+
+bool TabPage::eventFilter(QObject* watched, QEvent* event) {
+  if(event->type() == QEvent::KeyPress) {
+    QKeyEvent* keyEvent = static_cast<QKeyEvent*>(event);
+    QAbstractItemView* childView = folderView_->childView();
+    if(watched == filterBar_) {
+      switch(keyEvent->key()) {
+      case Qt::Key_Escape:
+        closeFilterBar();
+        childView->setFocus();
+        return true;
+      case Qt::Key_Return:
+      case Qt::Key_Enter:
+      case Qt::Key_Up:
+      case Qt::Key_Down:
+        // go back to the view to pick one of the files shown
+        childView->setFocus();
+        return true;
+      }
+    }
+    else if(watched == childView) {
+      if(keyEvent->key() == Qt::Key_Escape && filterBar_->isVisible()) {
+        closeFilterBar();
+        return true;
+      }
+      // start filtering when a printable char is typed in the view
+      QString text = keyEvent->text();
+      if(!text.isEmpty() && text[0].isPrint() && !text[0].isSpace()
+         && !(keyEvent->modifiers() & (Qt::ControlModifier|Qt::AltModifier|Qt::MetaModifier))) {
+        filterBar_->show();
+        filterBar_->setFocus();
+        filterBar_->setText(filterBar_->text() + text);
+        return true;
+      }
+    }
+  }
+  return QWidget::eventFilter(watched, event);
+}
+
 };
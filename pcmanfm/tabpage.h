@@ -23,6 +23,7 @@
 
 #include <QWidget>
 #include <QVBoxLayout>
+#include <QLineEdit>
 #include <libfm/fm.h>
 #include "browsehistory.h"
 #include "view.h"
@@ -32,12 +33,14 @@ namespace Fm {
   class FolderModel;
   class ProxyFolderModel;
   class CachedFolderModel;
+  class SearchFolderModel;
 };
 
 namespace PCManFM {
 
 class Settings;
 class Launcher;
+class NameFilter;
 
 class TabPage : public QWidget {
 Q_OBJECT
@@ -62,6 +65,8 @@ public:
 
   void setViewMode(Fm::FolderView::ViewMode mode) {
     folderView_->setViewMode(mode);
+    // the child view is recreated when the view mode is changed
+    folderView_->childView()->installEventFilter(this);
   }
 
   void sort(int col, Qt::SortOrder order = Qt::AscendingOrder) {
@@ -102,7 +107,7 @@ public:
   }
 
   FmPath* path() {
-    return folder_ ? fm_folder_get_path(folder_) : NULL;
+    return folder_ ? fm_folder_get_path(folder_) : searchPath_;
   }
 
   QString pathName();
@@ -111,9 +116,7 @@ public:
     return folder_;
   }
 
-  Fm::FolderModel* folderModel() {
-    return reinterpret_cast<Fm::FolderModel*>(folderModel_);
-  }
+  Fm::FolderModel* folderModel();
 
   View* folderView() {
     return folderView_;
@@ -135,10 +138,7 @@ public:
 
   void invertSelection();
 
-  void reload() {
-    if(folder_)
-      fm_folder_reload(folder_);
-  }
+  void reload();
 
   QString title() const {
     return title_;
@@ -184,10 +184,21 @@ protected Q_SLOTS:
   void onOpenDirRequested(FmPath* path, int target);
   void onModelSortFilterChanged();
   void onSelChanged(int numSel);
+  void onSearchFinished();
+  void updateSearchStatus();
+  void onFilterTextChanged(const QString& text);
+
+protected:
+  virtual bool eventFilter(QObject* watched, QEvent* event);
 
 private:
   void freeFolder();
+  void freeSearch();
+  void startSearch(FmPath* path);
+  void closeFilterBar();
   QString formatStatusText();
+  void saveFolderState();
+  void restoreFolderState();
 
   static void onFolderStartLoading(FmFolder* _folder, TabPage* pThis);
   static void onFolderFinishLoading(FmFolder* _folder, TabPage* pThis);
@@ -203,10 +214,15 @@ private:
   Fm::ProxyFolderModel* proxyModel_;
   QVBoxLayout* verticalLayout;
   FmFolder* folder_;
+  Fm::SearchFolderModel* searchModel_; // used instead of the folder when showing search results
+  QLineEdit* filterBar_;
+  NameFilter* nameFilter_; // set while the filter bar has some text
+  FmPath* searchPath_;
   QString title_;
   QString statusText_[StatusTextNum];
   Fm::BrowseHistory history_; // browsing history
   bool overrideCursor_;
+  bool restoreStatePending_; // restore the state stored in history once the folder is loaded
 };
 
 }
@@ -81,7 +81,26 @@ void View::onOpenInTerminal() {
 }
 
 void View::onSearch() {
-  
+  Application* app = static_cast<Application*>(qApp);
+  Fm::FileMenu* menu = static_cast<Fm::FileMenu*>(sender()->parent());
+  QStringList paths;
+  // only dirs can be search roots
+  for(GList* l = fm_file_info_list_peek_head_link(menu->files()); l; l = l->next) {
+    FmFileInfo* file = FM_FILE_INFO(l->data);
+    if(!fm_file_info_is_dir(file))
+      continue;
+    char* path = fm_path_to_str(fm_file_info_get_path(file));
+    paths.append(QString::fromLocal8Bit(path));
+    g_free(path);
+  }
+  // search in the current folder if only files are selected
+  if(paths.isEmpty() && menu->cwd()) {
+    char* path = fm_path_to_str(menu->cwd());
+    paths.append(QString::fromLocal8Bit(path));
+    g_free(path);
+  }
+  if(!paths.isEmpty())
+    app->findFiles(paths);
 }
 
 void View::prepareFileMenu(Fm::FileMenu* menu) {
@@ -111,9 +130,11 @@ void View::prepareFileMenu(Fm::FileMenu* menu) {
   connect(action, SIGNAL(triggered(bool)), SLOT(onNewWindow()));
   menu->insertAction(menu->separator1(), action);
 
-  // TODO: add search
-  // action = menu->addAction(_("Search"));
   if(all_native) {
+    action = new QAction(QIcon::fromTheme("system-search"), tr("&Search..."), menu);
+    connect(action, SIGNAL(triggered(bool)), SLOT(onSearch()));
+    menu->insertAction(menu->separator1(), action);
+
     action = new QAction(QIcon::fromTheme("utilities-terminal"), tr("Open in Termina&l"), menu);
     connect(action, SIGNAL(triggered(bool)), SLOT(onOpenInTerminal()));
     menu->insertAction(menu->separator1(), action);